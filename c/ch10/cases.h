@@ -10,11 +10,37 @@ PetscReal a_lin(PetscReal u, PetscReal x, PetscReal y) {
     return 1.0;
 }
 
+// batched forms, as used by unfem.c FormFunction():  out[i] = a(u[i],x[i],y[i])
+// for i = 0,...,n-1, by calling the pointwise forms
+void a_lin_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                 const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = a_lin(u[i],x[i],y[i]);
+}
+
+// derivative of a_lin() with respect to u:
+PetscReal da_lin(PetscReal u, PetscReal x, PetscReal y) {
+    return 0.0;
+}
+
 // manufactured from a_lin(), uexact_lin():
 PetscReal f_lin(PetscReal u, PetscReal x, PetscReal y) {
     return 2.0 * x + 3.0 * y * y;
 }
 
+void f_lin_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                 const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = f_lin(u[i],x[i],y[i]);
+}
+
+// derivative of f_lin() with respect to u:
+PetscReal df_lin(PetscReal u, PetscReal x, PetscReal y) {
+    return 0.0;
+}
+
 PetscReal uexact_lin(PetscReal x, PetscReal y) {
     const PetscReal y2 = y * y;
     return 1.0 - x * y2 - 0.25 * y2 * y2;
@@ -39,6 +65,17 @@ PetscReal a_nonlin(PetscReal u, PetscReal x, PetscReal y) {
     return 1.0 + u * u;
 }
 
+void a_nonlin_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                    const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = a_nonlin(u[i],x[i],y[i]);
+}
+
+PetscReal da_nonlin(PetscReal u, PetscReal x, PetscReal y) {
+    return 2.0 * u;
+}
+
 // manufactured from a_nonlin(), uexact_lin()
 PetscReal f_nonlin(PetscReal udrop, PetscReal x, PetscReal y) {
     const PetscReal y2 = y * y,
@@ -49,6 +86,14 @@ PetscReal f_nonlin(PetscReal udrop, PetscReal x, PetscReal y) {
            + (1.0 + u * u) * (2.0 * x + 3.0 * y2);
 }
 
+void f_nonlin_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                    const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = f_nonlin(u[i],x[i],y[i]);
+}
+
+// df_nonlin = df_lin  (f_nonlin() does not depend on u)
 // uexact_nonlin = uexact_lin
 // gD_nonlin = gD_lin
 // gN_nonlin = gN_lin
@@ -60,7 +105,11 @@ PetscReal f_nonlin(PetscReal udrop, PetscReal x, PetscReal y) {
 // USE: trapneu.poly
 
 // a_linneu = a_lin
+// a_linneu_batch = a_lin_batch
+// da_linneu = da_lin
 // f_linneu = f_lin
+// f_linneu_batch = f_lin_batch
+// df_linneu = df_lin
 // uexact_linneu = uexact_lin
 // gD_linneu = gD_lin
 
@@ -80,11 +129,25 @@ PetscReal a_square(PetscReal u, PetscReal x, PetscReal y) {
     return 1.0;
 }
 
+void a_square_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                    const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = a_square(u[i],x[i],y[i]);
+}
+
 // manufactured from a_square(), uexact_square():
 PetscReal f_square(PetscReal u, PetscReal x, PetscReal y) {
     return x * exp(y);  // note  f = - (u_xx + u_yy) = - u
 }
 
+void f_square_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                    const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = f_square(u[i],x[i],y[i]);
+}
+
 PetscReal uexact_square(PetscReal x, PetscReal y) {
     return - x * exp(y);
 }
@@ -94,6 +157,9 @@ PetscReal gD_square(PetscReal x, PetscReal y) {
     return uexact_square(x,y);
 }
 
+// da_square = da_lin
+// df_square = df_lin
+
 // gN_fcn() = NULL in square case; want seg fault if called
 
 
@@ -110,6 +176,23 @@ PetscReal f_koch(PetscReal u, PetscReal x, PetscReal y) {
     return 2.0;
 }
 
+void a_koch_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                  const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = a_koch(u[i],x[i],y[i]);
+}
+
+void f_koch_batch(PetscInt n, const PetscReal u[], const PetscReal x[],
+                  const PetscReal y[], PetscReal out[]) {
+    PetscInt i;
+    for (i = 0; i < n; i++)
+        out[i] = f_koch(u[i],x[i],y[i]);
+}
+
+// da_koch = da_lin
+// df_koch = df_lin
+
 PetscReal gD_koch(PetscReal x, PetscReal y) {
     return 0.0;
 }
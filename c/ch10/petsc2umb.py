@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# Convert a mesh stored as PETSc binary files .vec,.is (e.g. from msh2petsc.py)
+# into a single file .umb which unfem reads with UMReadMapped(); see um.h
+# and the UMMappedHeader struct in um.c for the layout.
+
+# example:
+#    $ make petscPyScripts
+#    $ ./petsc2umb.py meshes/trap1
+#    $ ./unfem -un_mesh meshes/trap1.umb
+
+import numpy as np
+import struct
+import sys
+
+VERSION = 1
+ALIGN = 64
+
+def aligned(off):
+    return ALIGN * ((off + ALIGN - 1) // ALIGN)
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(description= \
+'''Converts a mesh in PETSc binary files ROOT.vec and ROOT.is into a single
+file ROOT.umb, in native byte order, which can be memory-mapped.  Needs link to
+${PETSC_DIR}/lib/petsc/bin/PetscBinaryIO.py.''')
+    parser.add_argument('--int64', default=False, action='store_true',
+                        help='write 64-bit integers (for PETSc configured --with-64-bit-indices)')
+    parser.add_argument('root', metavar='ROOT',
+                        help='input file name root; reads ROOT.vec,ROOT.is')
+    args = parser.parse_args()
+
+    import PetscBinaryIO
+
+    petsc = PetscBinaryIO.PetscBinaryIO()
+    xy, = petsc.readBinaryFile(args.root + '.vec')
+    e, bf, ns = petsc.readBinaryFile(args.root + '.is')
+    idt = np.int64 if args.int64 else np.int32
+    xy = np.asarray(xy, dtype=np.float64)
+    e = np.asarray(e, dtype=idt)
+    bf = np.asarray(bf, dtype=idt)
+    ns = np.asarray(ns, dtype=idt)
+
+    if len(xy) % 2 != 0 or len(e) % 3 != 0 or len(ns) % 2 != 0:
+        print('ERROR: array lengths not multiples of 2,3,2 ... stopping')
+        sys.exit(1)
+    N, K = len(xy) // 2, len(e) // 3
+    if len(bf) != N:
+        print('ERROR: boundary flag list not length N ... stopping')
+        sys.exit(1)
+    if len(ns) > 0 and ns[0] < 0:   # msh2petsc.py writes [-1,-1] if P=0
+        ns = ns[:0]
+    P = len(ns) // 2
+
+    # header is struct UMMappedHeader in um.c
+    hfmt = '=8s4i7q'
+    offloc = aligned(struct.calcsize(hfmt))
+    offe = aligned(offloc + xy.nbytes)
+    offbf = aligned(offe + e.nbytes)
+    offns = aligned(offbf + bf.nbytes) if P > 0 else 0
+    header = struct.pack(hfmt, b'PETSCUM\0', VERSION, 0x01020304,
+                         idt().itemsize, 8, N, K, P,
+                         offloc, offe, offbf, offns)
+
+    outname = args.root + '.umb'
+    print('  writing N=%d nodes, K=%d elements, P=%d Neumann segments to %s ...' \
+          % (N,K,P,outname))
+    with open(outname, 'wb') as f:
+        f.write(header)
+        for off, a in [(offloc, xy), (offe, e), (offbf, bf), (offns, ns)]:
+            if a.nbytes > 0:
+                f.write(b'\0' * (off - f.tell()))
+                f.write(a.tobytes())
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+#
+# Throughput benchmark for unfem on a ladder of structured meshes of the unit
+# square (case 3).  For each mesh, unfem runs with -log_view, and the stage
+# times are converted to rates:
+#   read       bytes/s     mesh file bytes / "Read mesh" stage time
+#   residual   elements/s  K * (residual evaluations) / "Residual eval" time
+#   jacobian   elements/s  K * (Jacobian evaluations) / "Jacobian eval" time
+#   solve      DOFs/s      N / "Solver" stage time
+# Stages are exclusive in -log_view, so the "Solver" time excludes the
+# residual and Jacobian assembly done inside SNESSolve().  Results go out as
+# JSON with the git revision and machine information.
+#
+# run as:
+#   cd c/ch10/
+#   make petscPyScripts unfem         # use PETSC_ARCH with --with-debugging=0
+#   make bench-unfem                  # or:  ./study/bench-unfem.py -h
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import time
+
+STAGES = {'Read mesh': 'read', 'Set-up': 'setup', 'Solver': 'solver',
+          'Residual eval': 'residual', 'Jacobian eval': 'jacobian'}
+
+def sh(cmd):
+    return subprocess.run(cmd, shell=True, stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT,
+                          universal_newlines=True).stdout.strip()
+
+def gitinfo():
+    rev = sh('git rev-parse HEAD 2>/dev/null')
+    dirty = len(sh('git status --porcelain --untracked-files=no 2>/dev/null')) > 0
+    return {'revision': rev if len(rev) > 0 else None, 'dirty': dirty}
+
+def machineinfo():
+    cpu = platform.processor()
+    if os.path.exists('/proc/cpuinfo'):
+        with open('/proc/cpuinfo') as f:
+            for line in f:
+                if line.startswith('model name'):
+                    cpu = line.split(':', 1)[1].strip()
+                    break
+    return {'hostname': platform.node(), 'system': platform.platform(),
+            'machine': platform.machine(), 'cpu': cpu,
+            'cpu_count': os.cpu_count(),
+            'petsc_dir': os.environ.get('PETSC_DIR'),
+            'petsc_arch': os.environ.get('PETSC_ARCH')}
+
+def parselogview(out):
+    '''Stage times from "Summary of Stages" and event counts summed over
+    stages.'''
+    times, counts = {}, {'SNESFunctionEval': 0, 'SNESJacobianEval': 0}
+    insummary = False
+    for line in out.splitlines():
+        if line.startswith('Summary of Stages:'):
+            insummary = True
+            continue
+        if insummary:
+            m = re.match(r'^\s*\d+:\s*(.+?)\s*:\s+([0-9.eE+-]+)\s', line)
+            if m:
+                if m.group(1) in STAGES:
+                    times[STAGES[m.group(1)]] = float(m.group(2))
+                continue
+            if len(line.strip()) == 0 or line.startswith('---'):
+                insummary = False
+            continue
+        m = re.match(r'^(SNESFunctionEval|SNESJacobianEval)\s+(\d+)\s', line)
+        if m:
+            counts[m.group(1)] += int(m.group(2))
+    return times, counts
+
+def rate(num, t):
+    return num / t if (t is not None and t > 0.0) else None
+
+def runone(args, M):
+    root = os.path.join('meshes', 'bench%d' % M)
+    if not (os.path.exists(root + '.vec') and os.path.exists(root + '.is')):
+        print('  generating %s.{vec,is} ...' % root, file=sys.stderr)
+        sh('./genstructured.py %s %d' % (root, M))
+    nbytes = os.path.getsize(root + '.vec') + os.path.getsize(root + '.is')
+    N, K = M * M, 2 * (M - 1) * (M - 1)
+    cmd = './unfem -un_case 3 -un_mesh %s %s -log_view' % (root, args.opts)
+    if args.np > 1:
+        cmd = 'mpiexec -n %d %s' % (args.np, cmd)
+    print('  running: %s' % cmd, file=sys.stderr)
+    t0 = time.time()
+    out = sh(cmd)
+    wall = time.time() - t0
+    if not re.search(r'case 3 result', out):
+        print('ERROR: unfem failed; output follows:\n' + out, file=sys.stderr)
+        sys.exit(1)
+    times, counts = parselogview(out)
+    nres, njac = counts['SNESFunctionEval'], counts['SNESJacobianEval']
+    return {'M': M, 'N': N, 'K': K, 'mesh_bytes': nbytes,
+            'residual_evals': nres, 'jacobian_evals': njac,
+            'wall_seconds': wall, 'stage_seconds': times,
+            'read_bytes_per_second': rate(nbytes, times.get('read')),
+            'residual_elements_per_second': rate(K * nres, times.get('residual')),
+            'jacobian_elements_per_second': rate(K * njac, times.get('jacobian')),
+            'solve_dofs_per_second': rate(N, times.get('solver'))}
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description= \
+'''Run unfem on a ladder of structured meshes and write per-stage throughput
+as JSON.  Run from c/ch10/ after "make unfem".  Meshes meshes/benchM.{vec,is}
+are generated by genstructured.py if missing.''')
+    parser.add_argument('--ladder', default='65,129,257,513,1025',
+                        help='comma-separated nodes per side M (default: %(default)s)')
+    parser.add_argument('--np', type=int, default=1,
+                        help='number of MPI processes (default: %(default)s)')
+    parser.add_argument('--opts', default='-snes_rtol 1.0e-10 -pc_type gamg',
+                        help='further unfem options (default: "%(default)s")')
+    parser.add_argument('-o', '--output', default=None,
+                        help='write JSON here instead of stdout')
+    args = parser.parse_args()
+
+    results = {'benchmark': 'unfem', 'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+               'git': gitinfo(), 'machine': machineinfo(),
+               'np': args.np, 'options': args.opts, 'runs': []}
+    for M in [int(s) for s in args.ladder.split(',')]:
+        results['runs'].append(runone(args, M))
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=2)
+            f.write('\n')
+        print('  results written to %s' % args.output, file=sys.stderr)
+    else:
+        print(json.dumps(results, indent=2))
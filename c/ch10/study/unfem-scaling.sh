@@ -0,0 +1,31 @@
+#!/bin/bash
+set -e
+
+# strong scaling of case 0 of unfem on a fixed mesh using CG+GAMG;
+# run as:
+#   cd c/ch10/
+#   make unfem                        # use PETSC_ARCH with --with-debugging=0
+#   ./refinetraps.sh meshes/trap 12   # generate meshes/trapN.{is,vec} for N=1,...,12
+#   cd study/
+#   ./unfem-scaling.sh 12 &> unfem-scaling.txt
+# first argument is mesh level (default 12); processes are 1,2,4,...,64
+
+LEV=${1:-12}
+
+function run() {
+    CMD="mpiexec -n $1 ../unfem -un_case 0 -un_mesh ../meshes/trap$LEV -snes_type ksponly -ksp_rtol 1.0e-10 -pc_type gamg -ksp_converged_reason -log_view"
+    echo "COMMAND:  $CMD"
+    rm -rf tmp.txt
+    $CMD &> tmp.txt
+    grep "Linear solve" tmp.txt
+    grep "result" tmp.txt
+    grep "Time (sec):     " tmp.txt
+    # read time percentages from these lines
+    grep "Read mesh      :" tmp.txt
+    grep "Set-up         :" tmp.txt
+    grep "Solver         :" tmp.txt
+}
+
+for NP in 1 2 4 8 16 32 64; do
+    run $NP
+done
@@ -1,4 +1,10 @@
 #include <petsc.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "um.h"
 
 PetscErrorCode UMInitialize(UM *mesh) {
@@ -9,6 +15,27 @@ PetscErrorCode UMInitialize(UM *mesh) {
     mesh->e = NULL;
     mesh->bf = NULL;
     mesh->ns = NULL;
+    mesh->Nown = 0;
+    mesh->Ngh = 0;
+    mesh->Kown = 0;
+    mesh->Pown = 0;
+    mesh->ltog = NULL;
+    mesh->geom = NULL;
+    mesh->perm = NULL;
+    mesh->ncolors = 0;
+    mesh->colorptr = NULL;
+    mesh->colorelts = NULL;
+    mesh->NE = 0;
+    mesh->edges = NULL;
+    mesh->ee = NULL;
+    mesh->ebf = NULL;
+    mesh->nse = NULL;
+    mesh->eltptr = NULL;
+    mesh->elts = NULL;
+    mesh->nbrptr = NULL;
+    mesh->nbrs = NULL;
+    mesh->map = NULL;
+    mesh->maplen = 0;
     return 0;
 }
 
@@ -18,32 +45,55 @@ PetscErrorCode UMDestroy(UM *mesh) {
     ierr = ISDestroy(&(mesh->e)); CHKERRQ(ierr);
     ierr = ISDestroy(&(mesh->bf)); CHKERRQ(ierr);
     ierr = ISDestroy(&(mesh->ns)); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingDestroy(&(mesh->ltog)); CHKERRQ(ierr);
+    if (mesh->geom) {
+        ierr = PetscFree(mesh->geom->x0); CHKERRQ(ierr);  // one block for all
+        ierr = PetscFree(mesh->geom->gD); CHKERRQ(ierr);
+        ierr = PetscFree(mesh->geom); CHKERRQ(ierr);
+    }
+    ierr = ISDestroy(&(mesh->perm)); CHKERRQ(ierr);
+    ierr = PetscFree2(mesh->colorptr,mesh->colorelts); CHKERRQ(ierr);
+    ierr = PetscFree4(mesh->edges,mesh->ee,mesh->ebf,mesh->nse); CHKERRQ(ierr);
+    ierr = PetscFree4(mesh->eltptr,mesh->elts,mesh->nbrptr,mesh->nbrs); CHKERRQ(ierr);
+    // only after the Vec and ISs which may point into it are gone
+    if (mesh->map) {
+        if (munmap(mesh->map,mesh->maplen) != 0) {
+            SETERRQ(PETSC_COMM_SELF,1,"munmap() of mesh file failed\n");
+        }
+        mesh->map = NULL;
+    }
     return 0;
 }
 
 PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
     PetscErrorCode ierr;
-    PetscInt        n, k;
+    PetscMPIInt     size, rank;
+    PetscInt        n, k, Nloc = mesh->Nown + mesh->Ngh;
     const Node      *aloc;
     const PetscInt  *ae, *abf, *ans;
 
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
     ierr = PetscViewerASCIIPushSynchronized(viewer); CHKERRQ(ierr);
+    if (size > 1) {
+        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"[rank %d] local mesh; %d owned and %d ghost nodes:\n",rank,mesh->Nown,mesh->Ngh); CHKERRQ(ierr);
+    }
     if (mesh->loc && (mesh->N > 0)) {
-        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d nodes at (x,y) coordinates:\n",mesh->N); CHKERRQ(ierr);
-        ierr = VecGetArrayRead(mesh->loc,(const PetscReal **)&aloc); CHKERRQ(ierr);
-        for (n = 0; n < mesh->N; n++) {
+        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d nodes at (x,y) coordinates:\n",Nloc); CHKERRQ(ierr);
+        ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+        for (n = 0; n < Nloc; n++) {
             ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : (%g,%g)\n",
                                n,aloc[n].x,aloc[n].y); CHKERRQ(ierr);
         }
-        ierr = VecRestoreArrayRead(mesh->loc,(const PetscReal **)&aloc); CHKERRQ(ierr);
+        ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
     } else {
         ierr = PetscViewerASCIISynchronizedPrintf(viewer,"node coordinates empty or unallocated\n"); CHKERRQ(ierr);
     }
     if (mesh->e && (mesh->K > 0)) {
-        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d elements:\n",mesh->K); CHKERRQ(ierr);
+        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d elements:\n",mesh->Kown); CHKERRQ(ierr);
         ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
-        for (k = 0; k < mesh->K; k++) {
-            ierr = PetscPrintf(PETSC_COMM_WORLD,"    %3d : %3d %3d %3d\n",
+        for (k = 0; k < mesh->Kown; k++) {
+            ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %3d %3d %3d\n",
                                k,ae[3*k+0],ae[3*k+1],ae[3*k+2]); CHKERRQ(ierr);
         }
         ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
@@ -51,9 +101,9 @@ PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
         ierr = PetscViewerASCIISynchronizedPrintf(viewer,"element index triples empty or unallocated\n"); CHKERRQ(ierr);
     }
     if (mesh->bf && (mesh->N > 0)) {
-        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d boundary flags at nodes (0 = interior, 1 = boundary, 2 = Dirichlet):\n",mesh->N); CHKERRQ(ierr);
+        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d boundary flags at nodes (0 = interior, 1 = boundary, 2 = Dirichlet):\n",Nloc); CHKERRQ(ierr);
         ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
-        for (n = 0; n < mesh->N; n++) {
+        for (n = 0; n < Nloc; n++) {
             ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %1d\n",
                                n,abf[n]); CHKERRQ(ierr);
         }
@@ -62,9 +112,9 @@ PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
         ierr = PetscViewerASCIISynchronizedPrintf(viewer,"boundary flags empty or unallocated\n"); CHKERRQ(ierr);
     }
     if (mesh->ns && (mesh->P > 0)) {
-        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d Neumann boundary segments:\n",mesh->P); CHKERRQ(ierr);
+        ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d Neumann boundary segments:\n",mesh->Pown); CHKERRQ(ierr);
         ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
-        for (n = 0; n < mesh->P; n++) {
+        for (n = 0; n < mesh->Pown; n++) {
             ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %3d %3d\n",
                                n,ans[2*n+0],ans[2*n+1]); CHKERRQ(ierr);
         }
@@ -72,6 +122,7 @@ PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
     } else {
         ierr = PetscViewerASCIISynchronizedPrintf(viewer,"Neumann boundary segments empty or unallocated\n"); CHKERRQ(ierr);
     }
+    ierr = PetscViewerFlush(viewer); CHKERRQ(ierr);
     ierr = PetscViewerASCIIPopSynchronized(viewer); CHKERRQ(ierr);
     return 0;
 }
@@ -80,6 +131,9 @@ PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
 PetscErrorCode UMViewSolutionBinary(UM *mesh, char *filename, Vec u) {
     PetscErrorCode ierr;
     PetscInt       Nu;
+    const PetscInt *aperm;
+    const PetscReal *au;
+    Vec            uorig;
     PetscViewer viewer;
     ierr = VecGetSize(u,&Nu); CHKERRQ(ierr);
     if (Nu != mesh->N) {
@@ -87,12 +141,214 @@ PetscErrorCode UMViewSolutionBinary(UM *mesh, char *filename, Vec u) {
            "incompatible sizes of u (=%d) and number of nodes (=%d)\n",Nu,mesh->N);
     }
     ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_WRITE,&viewer); CHKERRQ(ierr);
-    ierr = VecView(u,viewer); CHKERRQ(ierr);
+    if (mesh->perm) {  // undo reordering; owned values may go off-process
+        ierr = VecDuplicate(u,&uorig); CHKERRQ(ierr);
+        ierr = ISGetIndices(mesh->perm,&aperm); CHKERRQ(ierr);
+        ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
+        ierr = VecSetValues(uorig,mesh->Nown,aperm,au,INSERT_VALUES); CHKERRQ(ierr);
+        ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
+        ierr = ISRestoreIndices(mesh->perm,&aperm); CHKERRQ(ierr);
+        ierr = VecAssemblyBegin(uorig); CHKERRQ(ierr);
+        ierr = VecAssemblyEnd(uorig); CHKERRQ(ierr);
+        ierr = VecView(uorig,viewer); CHKERRQ(ierr);
+        ierr = VecDestroy(&uorig); CHKERRQ(ierr);
+    } else {
+        ierr = VecView(u,viewer); CHKERRQ(ierr);
+    }
     ierr = PetscViewerDestroy(&viewer); CHKERRQ(ierr);
     return 0;
 }
 
 
+/* VTK XML (.vtu) output.  The arrays go, raw and in order, into one
+appended-data block; each is a UInt64 byte count then the values.  Rank 0
+writes everything, including the other ranks' nodes and elements, which are
+received one rank at a time in chunks of at most VTUCHUNK entries, so no
+process ever holds more than its own mesh plus one chunk. */
+
+#define VTUCHUNK 65536
+
+typedef enum {VTU_POINTS, VTU_CONNECTIVITY, VTU_OFFSETS, VTU_TYPES,
+              VTU_SOLUTION} VTUArray;
+
+typedef struct {
+    const Node      *aloc;
+    const PetscInt  *ae;
+    const PetscReal *au;
+    ISLocalToGlobalMapping ltog;
+    PetscInt        kstart;   // global index of first owned element
+    PetscInt        *iwork;   // length 3*VTUCHUNK
+} VTUCtx;
+
+// bytes per entry (node or element) of each array
+static const size_t vtubytes[5] = {3*sizeof(double), 3*sizeof(int64_t),
+                                   sizeof(int64_t), sizeof(uint8_t),
+                                   sizeof(double)};
+
+// convert entries start,...,start+n-1 of this process's part of an array
+static PetscErrorCode VTUFillChunk(VTUCtx *c, VTUArray which,
+                                   PetscInt start, PetscInt n, void *buf) {
+    PetscErrorCode ierr;
+    double   *db = (double*)buf;
+    int64_t  *ib = (int64_t*)buf;
+    uint8_t  *ub = (uint8_t*)buf;
+    PetscInt i;
+    switch (which) {
+        case VTU_POINTS :
+            for (i = 0; i < n; i++) {
+                db[3*i+0] = c->aloc[start+i].x;
+                db[3*i+1] = c->aloc[start+i].y;
+                db[3*i+2] = 0.0;
+            }
+            break;
+        case VTU_CONNECTIVITY :
+            ierr = PetscArraycpy(c->iwork,c->ae + 3*start,3*n); CHKERRQ(ierr);
+            ierr = ISLocalToGlobalMappingApply(c->ltog,3*n,c->iwork,c->iwork); CHKERRQ(ierr);
+            for (i = 0; i < 3*n; i++)
+                ib[i] = c->iwork[i];
+            break;
+        case VTU_OFFSETS :
+            for (i = 0; i < n; i++)
+                ib[i] = 3 * (int64_t)(c->kstart + start + i + 1);
+            break;
+        case VTU_TYPES :
+            for (i = 0; i < n; i++)
+                ub[i] = 5;  // VTK_TRIANGLE
+            break;
+        case VTU_SOLUTION :
+            for (i = 0; i < n; i++)
+                db[i] = c->au[start+i];
+            break;
+    }
+    return 0;
+}
+
+// write one array of global length ntotal from local parts of length nlocal
+static PetscErrorCode VTUWriteArray(VTUCtx *c, VTUArray which, FILE *fp,
+                                    PetscInt nlocal, PetscInt ntotal,
+                                    void *buf) {
+    PetscErrorCode ierr;
+    PetscMPIInt  size, rank, q;
+    PetscInt     nq, start, n;
+    uint64_t     nbytes = (uint64_t)ntotal * vtubytes[which];
+
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    if (rank == 0) {
+        if (fwrite(&nbytes,sizeof(uint64_t),1,fp) != 1) {
+            SETERRQ(PETSC_COMM_SELF,3,"fwrite() to .vtu file failed\n");
+        }
+    }
+    for (q = 0; q < size; q++) {
+        if (rank == 0) {
+            nq = nlocal;
+            if (q > 0) {
+                ierr = MPI_Recv(&nq,1,MPIU_INT,q,0,PETSC_COMM_WORLD,
+                                MPI_STATUS_IGNORE); CHKERRQ(ierr);
+            }
+            for (start = 0; start < nq; start += VTUCHUNK) {
+                n = PetscMin(VTUCHUNK,nq - start);
+                if (q == 0) {
+                    ierr = VTUFillChunk(c,which,start,n,buf); CHKERRQ(ierr);
+                } else {
+                    ierr = MPI_Recv(buf,(PetscMPIInt)(n * vtubytes[which]),
+                                    MPI_BYTE,q,1,PETSC_COMM_WORLD,
+                                    MPI_STATUS_IGNORE); CHKERRQ(ierr);
+                }
+                if (fwrite(buf,vtubytes[which],n,fp) != (size_t)n) {
+                    SETERRQ(PETSC_COMM_SELF,3,"fwrite() to .vtu file failed\n");
+                }
+            }
+        } else if (rank == q) {
+            ierr = MPI_Send(&nlocal,1,MPIU_INT,0,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+            for (start = 0; start < nlocal; start += VTUCHUNK) {
+                n = PetscMin(VTUCHUNK,nlocal - start);
+                ierr = VTUFillChunk(c,which,start,n,buf); CHKERRQ(ierr);
+                ierr = MPI_Send(buf,(PetscMPIInt)(n * vtubytes[which]),
+                                MPI_BYTE,0,1,PETSC_COMM_WORLD); CHKERRQ(ierr);
+            }
+        }
+    }
+    return 0;
+}
+
+PetscErrorCode UMViewVTU(UM *mesh, char *filename, Vec u) {
+    PetscErrorCode ierr;
+    const uint16_t endian = 1;
+    PetscMPIInt  rank;
+    PetscInt     nu;
+    uint64_t     off[5];
+    uint8_t      *buf;
+    VTUCtx       c;
+    FILE         *fp;
+    int          j;
+
+    ierr = VecGetLocalSize(u,&nu); CHKERRQ(ierr);
+    if (nu < mesh->Nown) {
+        SETERRQ2(PETSC_COMM_SELF,1,
+           "local size of u (=%d) less than number of owned nodes (=%d)\n",
+           nu,mesh->Nown);
+    }
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    ierr = MPI_Scan(&(mesh->Kown),&(c.kstart),1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    c.kstart -= mesh->Kown;
+    c.ltog = mesh->ltog;
+
+    // offsets of the arrays in the appended data
+    off[0] = 0;
+    for (j = 1; j < 5; j++)
+        off[j] = off[j-1] + sizeof(uint64_t)
+                 + ((j-1 == VTU_POINTS || j-1 == VTU_SOLUTION) ? mesh->N : mesh->K)
+                   * vtubytes[j-1];
+
+    ierr = PetscFOpen(PETSC_COMM_WORLD,filename,"w",&fp); CHKERRQ(ierr);
+    ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,
+        "<?xml version=\"1.0\"?>\n"
+        "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+        "  <UnstructuredGrid>\n"
+        "    <Piece NumberOfPoints=\"%d\" NumberOfCells=\"%d\">\n"
+        "      <Points>\n"
+        "        <DataArray type=\"Float64\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%llu\"/>\n"
+        "      </Points>\n"
+        "      <Cells>\n"
+        "        <DataArray type=\"Int64\" Name=\"connectivity\" format=\"appended\" offset=\"%llu\"/>\n"
+        "        <DataArray type=\"Int64\" Name=\"offsets\" format=\"appended\" offset=\"%llu\"/>\n"
+        "        <DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"%llu\"/>\n"
+        "      </Cells>\n"
+        "      <PointData Scalars=\"u\">\n"
+        "        <DataArray type=\"Float64\" Name=\"u\" format=\"appended\" offset=\"%llu\"/>\n"
+        "      </PointData>\n"
+        "    </Piece>\n"
+        "  </UnstructuredGrid>\n"
+        "  <AppendedData encoding=\"raw\">\n_",
+        (*(const uint8_t*)&endian == 1) ? "LittleEndian" : "BigEndian",
+        mesh->N,mesh->K,
+        (unsigned long long)off[0],(unsigned long long)off[1],
+        (unsigned long long)off[2],(unsigned long long)off[3],
+        (unsigned long long)off[4]); CHKERRQ(ierr);
+
+    ierr = PetscMalloc2(VTUCHUNK * vtubytes[VTU_CONNECTIVITY],&buf,
+                        3*VTUCHUNK,&(c.iwork)); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&(c.aloc)); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&(c.ae)); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(u,&(c.au)); CHKERRQ(ierr);
+    ierr = VTUWriteArray(&c,VTU_POINTS,fp,mesh->Nown,mesh->N,buf); CHKERRQ(ierr);
+    ierr = VTUWriteArray(&c,VTU_CONNECTIVITY,fp,mesh->Kown,mesh->K,buf); CHKERRQ(ierr);
+    ierr = VTUWriteArray(&c,VTU_OFFSETS,fp,mesh->Kown,mesh->K,buf); CHKERRQ(ierr);
+    ierr = VTUWriteArray(&c,VTU_TYPES,fp,mesh->Kown,mesh->K,buf); CHKERRQ(ierr);
+    ierr = VTUWriteArray(&c,VTU_SOLUTION,fp,mesh->Nown,mesh->N,buf); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(u,&(c.au)); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&(c.ae)); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&(c.aloc)); CHKERRQ(ierr);
+    ierr = PetscFree2(buf,c.iwork); CHKERRQ(ierr);
+
+    ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,
+        "\n  </AppendedData>\n</VTKFile>\n"); CHKERRQ(ierr);
+    ierr = PetscFClose(PETSC_COMM_WORLD,fp); CHKERRQ(ierr);
+    return 0;
+}
+
+
 PetscErrorCode UMReadNodes(UM *mesh, char *filename) {
     PetscErrorCode ierr;
     PetscInt       twoN;
@@ -101,6 +357,7 @@ PetscErrorCode UMReadNodes(UM *mesh, char *filename) {
         SETERRQ(PETSC_COMM_SELF,1,"nodes already created?\n");
     }
     ierr = VecCreate(PETSC_COMM_WORLD,&mesh->loc); CHKERRQ(ierr);
+    ierr = VecSetBlockSize(mesh->loc,2); CHKERRQ(ierr);  // do not split (x,y) pairs
     ierr = VecSetFromOptions(mesh->loc); CHKERRQ(ierr);
     ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&viewer); CHKERRQ(ierr);
     ierr = VecLoad(mesh->loc,viewer); CHKERRQ(ierr);
@@ -110,10 +367,14 @@ PetscErrorCode UMReadNodes(UM *mesh, char *filename) {
         SETERRQ1(PETSC_COMM_SELF,2,"node locations loaded from %s are not N pairs\n",filename);
     }
     mesh->N = twoN / 2;
+    ierr = VecGetLocalSize(mesh->loc,&twoN); CHKERRQ(ierr);
+    mesh->Nown = twoN / 2;
     return 0;
 }
 
 
+// checks are applied to the loaded chunks, which still use global indices,
+// before UMSetUpGhosts() converts them to local indices
 PetscErrorCode UMCheckElements(UM *mesh) {
     PetscErrorCode ierr;
     const PetscInt  *ae;
@@ -127,7 +388,7 @@ PetscErrorCode UMCheckElements(UM *mesh) {
                 "node size unknown so element check impossible; call UMReadNodes() first\n");
     }
     ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
-    for (k = 0; k < mesh->K; k++) {
+    for (k = 0; k < mesh->Kown; k++) {
         for (m = 0; m < 3; m++) {
             if ((ae[3*k+m] < 0) || (ae[3*k+m] >= mesh->N)) {
                 SETERRQ3(PETSC_COMM_SELF,3,
@@ -158,7 +419,7 @@ PetscErrorCode UMCheckBoundaryData(UM *mesh) {
                 "inconsistent data for Neumann boundary segments\n");
     }
     ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
-    for (n = 0; n < mesh->N; n++) {
+    for (n = 0; n < mesh->Nown; n++) {
         switch (abf[n]) {
             case 0 :
             case 1 :
@@ -173,7 +434,7 @@ PetscErrorCode UMCheckBoundaryData(UM *mesh) {
     ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
     if (mesh->P > 0) {
         ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
-        for (n = 0; n < mesh->P; n++) {
+        for (n = 0; n < mesh->Pown; n++) {
             for (m = 0; m < 2; m++) {
                 if ((ans[2*n+m] < 0) || (ans[2*n+m] >= mesh->N)) {
                     SETERRQ3(PETSC_COMM_SELF,6,
@@ -187,10 +448,136 @@ PetscErrorCode UMCheckBoundaryData(UM *mesh) {
     return 0;
 }
 
+// convert global node index to local:  owned nodes are contiguous,
+//   ghosts are sorted and found by bisection
+static PetscErrorCode GlobalToLocalNode(PetscInt g, PetscInt rstart,
+        PetscInt Nown, PetscInt Ngh, const PetscInt *ghosts, PetscInt *l) {
+    PetscErrorCode ierr;
+    PetscInt j;
+    if ((g >= rstart) && (g < rstart + Nown)) {
+        *l = g - rstart;
+    } else {
+        ierr = PetscFindInt(g,Ngh,ghosts,&j); CHKERRQ(ierr);
+        if (j < 0) {
+            SETERRQ1(PETSC_COMM_SELF,1,"node %d not owned and not a ghost\n",g);
+        }
+        *l = Nown + j;
+    }
+    return 0;
+}
+
+/* Build the parallel layout from the chunks loaded by UMReadNodes() and
+UMReadISs():  find ghost nodes, create the local-to-global map, replace loc by
+a ghosted Vec, and replace e, bf, ns by sequential ISs with local indices.
+The boundary flags of ghost nodes come from their owners through a ghosted
+Vec.  On one process this merely copies. */
+static PetscErrorCode UMSetUpGhosts(UM *mesh) {
+    PetscErrorCode ierr;
+    const PetscInt  *ae, *abf, *ans = NULL;
+    const PetscReal *aloc;
+    PetscInt        rstart, rend, nref, Nloc, j, n, *ghosts, *ltogidx,
+                    *ael, *abfl, *ansl = NULL;
+    PetscReal       *alocg, *avbf;
+    Vec             locg, vbf, vbfl;
+
+    ierr = VecGetOwnershipRange(mesh->loc,&rstart,&rend); CHKERRQ(ierr);
+    rstart /= 2;
+    rend /= 2;
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+
+    // ghosts are referenced nodes which are not owned
+    ierr = PetscMalloc1(3*mesh->Kown+2*mesh->Pown,&ghosts); CHKERRQ(ierr);
+    nref = 0;
+    for (j = 0; j < 3*mesh->Kown; j++)
+        if ((ae[j] < rstart) || (ae[j] >= rend))
+            ghosts[nref++] = ae[j];
+    for (j = 0; j < 2*mesh->Pown; j++)
+        if ((ans[j] < rstart) || (ans[j] >= rend))
+            ghosts[nref++] = ans[j];
+    ierr = PetscSortRemoveDupsInt(&nref,ghosts); CHKERRQ(ierr);
+    mesh->Ngh = nref;
+    Nloc = mesh->Nown + mesh->Ngh;
+
+    // local-to-global map
+    ierr = PetscMalloc1(Nloc,&ltogidx); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++)
+        ltogidx[n] = rstart + n;
+    for (n = 0; n < mesh->Ngh; n++)
+        ltogidx[mesh->Nown+n] = ghosts[n];
+    ierr = ISLocalToGlobalMappingCreate(PETSC_COMM_WORLD,1,Nloc,ltogidx,
+               PETSC_OWN_POINTER,&(mesh->ltog)); CHKERRQ(ierr);
+
+    // element triples and Neumann segments in local indices
+    ierr = PetscMalloc1(3*mesh->Kown,&ael); CHKERRQ(ierr);
+    for (j = 0; j < 3*mesh->Kown; j++) {
+        ierr = GlobalToLocalNode(ae[j],rstart,mesh->Nown,mesh->Ngh,ghosts,
+                                 &(ael[j])); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,3*mesh->Kown,ael,
+                           PETSC_OWN_POINTER,&(mesh->e)); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = PetscMalloc1(2*mesh->Pown,&ansl); CHKERRQ(ierr);
+        for (j = 0; j < 2*mesh->Pown; j++) {
+            ierr = GlobalToLocalNode(ans[j],rstart,mesh->Nown,mesh->Ngh,ghosts,
+                                     &(ansl[j])); CHKERRQ(ierr);
+        }
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        ierr = ISDestroy(&(mesh->ns)); CHKERRQ(ierr);
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,2*mesh->Pown,ansl,
+                               PETSC_OWN_POINTER,&(mesh->ns)); CHKERRQ(ierr);
+    }
+
+    // node coordinates into ghosted Vec
+    ierr = VecCreateGhostBlock(PETSC_COMM_WORLD,2,2*mesh->Nown,2*mesh->N,
+                               mesh->Ngh,ghosts,&locg); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(mesh->loc,&aloc); CHKERRQ(ierr);
+    ierr = VecGetArray(locg,&alocg); CHKERRQ(ierr);
+    ierr = PetscArraycpy(alocg,aloc,2*mesh->Nown); CHKERRQ(ierr);
+    ierr = VecRestoreArray(locg,&alocg); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(mesh->loc,&aloc); CHKERRQ(ierr);
+    ierr = VecDestroy(&(mesh->loc)); CHKERRQ(ierr);
+    mesh->loc = locg;
+    ierr = VecGhostUpdateBegin(mesh->loc,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = VecGhostUpdateEnd(mesh->loc,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+
+    // boundary flags, including at ghosts
+    ierr = VecCreateGhost(PETSC_COMM_WORLD,mesh->Nown,mesh->N,
+                          mesh->Ngh,ghosts,&vbf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecGetArray(vbf,&avbf); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++)
+        avbf[n] = (PetscReal)abf[n];
+    ierr = VecRestoreArray(vbf,&avbf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecGhostUpdateBegin(vbf,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = VecGhostUpdateEnd(vbf,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = PetscMalloc1(Nloc,&abfl); CHKERRQ(ierr);
+    ierr = VecGhostGetLocalForm(vbf,&vbfl); CHKERRQ(ierr);
+    ierr = VecGetArray(vbfl,&avbf); CHKERRQ(ierr);
+    for (n = 0; n < Nloc; n++)
+        abfl[n] = (PetscInt)avbf[n];
+    ierr = VecRestoreArray(vbfl,&avbf); CHKERRQ(ierr);
+    ierr = VecGhostRestoreLocalForm(vbf,&vbfl); CHKERRQ(ierr);
+    ierr = VecDestroy(&vbf); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->bf)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,Nloc,abfl,
+                           PETSC_OWN_POINTER,&(mesh->bf)); CHKERRQ(ierr);
+
+    ierr = PetscFree(ghosts); CHKERRQ(ierr);
+    return 0;
+}
+
 PetscErrorCode UMReadISs(UM *mesh, char *filename) {
     PetscErrorCode ierr;
     PetscViewer  viewer;
-    PetscInt     n_bf;
+    PetscLayout  map;
+    PetscInt     n_bf, n_ns;
+    PetscBool    noneumann, anynoneumann;
     if ((!mesh->loc) || (mesh->N == 0)) {
         SETERRQ(PETSC_COMM_SELF,2,
                 "node coordinates not created ... do that first ... stopping\n");
@@ -200,16 +587,22 @@ PetscErrorCode UMReadISs(UM *mesh, char *filename) {
                 "elements, boundary flags, Neumann boundary segments already created? ... stopping\n");
     }
     ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&viewer); CHKERRQ(ierr);
-    // create and load e
+    // create and load e; on P processes each gets a contiguous chunk of
+    //   whole triples, because the layout block size makes ISLoad() split
+    //   the K triples, not the 3K entries, as in UMSplitOwnership()
     ierr = ISCreate(PETSC_COMM_WORLD,&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISGetLayout(mesh->e,&map); CHKERRQ(ierr);
+    ierr = PetscLayoutSetBlockSize(map,3); CHKERRQ(ierr);
     ierr = ISLoad(mesh->e,viewer); CHKERRQ(ierr);
     ierr = ISGetSize(mesh->e,&(mesh->K)); CHKERRQ(ierr);
-    if (mesh->K % 3 != 0) {
+    ierr = ISGetLocalSize(mesh->e,&(mesh->Kown)); CHKERRQ(ierr);
+    if ((mesh->K % 3 != 0) || (mesh->Kown % 3 != 0)) {
         SETERRQ1(PETSC_COMM_SELF,3,
                  "IS e loaded from %s is wrong size for list of element triples\n",filename);
     }
     mesh->K /= 3;
-    // create and load bf
+    mesh->Kown /= 3;
+    // create and load bf; its layout must match the owned nodes
     ierr = ISCreate(PETSC_COMM_WORLD,&(mesh->bf)); CHKERRQ(ierr);
     ierr = ISLoad(mesh->bf,viewer); CHKERRQ(ierr);
     ierr = ISGetSize(mesh->bf,&n_bf); CHKERRQ(ierr);
@@ -217,32 +610,703 @@ PetscErrorCode UMReadISs(UM *mesh, char *filename) {
         SETERRQ1(PETSC_COMM_SELF,4,
                  "IS bf loaded from %s is wrong size for list of boundary flags\n",filename);
     }
+    ierr = ISGetLocalSize(mesh->bf,&n_bf); CHKERRQ(ierr);
+    if (n_bf != mesh->Nown) {
+        SETERRQ(PETSC_COMM_SELF,5,
+                "IS bf layout does not match ownership of node coordinates\n");
+    }
     // FIXME  seems there is no way to tell if file is empty at this point
-    // create and load ns last ... may *start with a negative value* in which case set P = 0
+    // create and load ns last ... may *start with a negative value* in which case set P = 0;
+    //   split in whole pairs, as for e
     const PetscInt *ans;
     ierr = ISCreate(PETSC_COMM_WORLD,&(mesh->ns)); CHKERRQ(ierr);
+    ierr = ISGetLayout(mesh->ns,&map); CHKERRQ(ierr);
+    ierr = PetscLayoutSetBlockSize(map,2); CHKERRQ(ierr);
     ierr = ISLoad(mesh->ns,viewer); CHKERRQ(ierr);
+    ierr = ISGetLocalSize(mesh->ns,&n_ns); CHKERRQ(ierr);
     ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
-    if (ans[0] < 0) {
+    noneumann = ((n_ns > 0) && (ans[0] < 0)) ? PETSC_TRUE : PETSC_FALSE;
+    ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    ierr = MPI_Allreduce(&noneumann,&anynoneumann,1,MPIU_BOOL,MPI_LOR,
+                         PETSC_COMM_WORLD); CHKERRQ(ierr);
+    if (anynoneumann) {
         ISDestroy(&(mesh->ns));
         mesh->ns = NULL;
         mesh->P = 0;
+        mesh->Pown = 0;
     } else {
         ierr = ISGetSize(mesh->ns,&(mesh->P)); CHKERRQ(ierr);
-        if (mesh->P % 2 != 0) {
+        if ((mesh->P % 2 != 0) || (n_ns % 2 != 0)) {
             SETERRQ1(PETSC_COMM_SELF,4,
                      "IS s loaded from %s is wrong size for list of Neumann boundary segment pairs\n",filename);
         }
         mesh->P /= 2;
+        mesh->Pown = n_ns / 2;
     }
     ierr = PetscViewerDestroy(&viewer); CHKERRQ(ierr);
 
     // check that mesh is complete now
     ierr = UMCheckElements(mesh); CHKERRQ(ierr);
     ierr = UMCheckBoundaryData(mesh); CHKERRQ(ierr);
+
+    // distribute:  ghosts, local indices, local-to-global map
+    ierr = UMSetUpGhosts(mesh); CHKERRQ(ierr);
+    return 0;
+}
+
+
+// given N, K, P, set Nown, Kown, Pown for the default contiguous layout, the
+//   same as from VecLoad() of loc (block size 2) and from ISLoad() of bf, e,
+//   ns in UMReadISs() (block sizes 1, 3, 2), and return the starts of the chunks
+static PetscErrorCode UMSplitOwnership(UM *mesh, PetscInt *nstart,
+                                       PetscInt *kstart, PetscInt *pstart) {
+    PetscErrorCode ierr;
+    mesh->Nown = PETSC_DECIDE;
+    mesh->Kown = PETSC_DECIDE;
+    mesh->Pown = PETSC_DECIDE;
+    ierr = PetscSplitOwnership(PETSC_COMM_WORLD,&(mesh->Nown),&(mesh->N)); CHKERRQ(ierr);
+    ierr = PetscSplitOwnership(PETSC_COMM_WORLD,&(mesh->Kown),&(mesh->K)); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = PetscSplitOwnership(PETSC_COMM_WORLD,&(mesh->Pown),&(mesh->P)); CHKERRQ(ierr);
+    } else {
+        mesh->Pown = 0;
+    }
+    ierr = MPI_Scan(&(mesh->Nown),nstart,1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = MPI_Scan(&(mesh->Kown),kstart,1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = MPI_Scan(&(mesh->Pown),pstart,1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    *nstart -= mesh->Nown;
+    *kstart -= mesh->Kown;
+    *pstart -= mesh->Pown;
+    return 0;
+}
+
+// create loc, e, bf, ns by copying this process's chunks (global indices),
+//   which have the sizes set by UMSplitOwnership(), then check and distribute
+static PetscErrorCode UMCreateFromChunks(UM *mesh, const PetscReal *aloc,
+        const PetscInt *ae, const PetscInt *abf, const PetscInt *ans) {
+    PetscErrorCode ierr;
+    PetscReal      *aown;
+    ierr = VecCreate(PETSC_COMM_WORLD,&(mesh->loc)); CHKERRQ(ierr);
+    ierr = VecSetSizes(mesh->loc,2*mesh->Nown,2*mesh->N); CHKERRQ(ierr);
+    ierr = VecSetBlockSize(mesh->loc,2); CHKERRQ(ierr);
+    ierr = VecSetFromOptions(mesh->loc); CHKERRQ(ierr);
+    ierr = VecGetArray(mesh->loc,&aown); CHKERRQ(ierr);
+    ierr = PetscArraycpy(aown,aloc,2*mesh->Nown); CHKERRQ(ierr);
+    ierr = VecRestoreArray(mesh->loc,&aown); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_WORLD,3*mesh->Kown,ae,
+               PETSC_COPY_VALUES,&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_WORLD,mesh->Nown,abf,
+               PETSC_COPY_VALUES,&(mesh->bf)); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = ISCreateGeneral(PETSC_COMM_WORLD,2*mesh->Pown,ans,
+                   PETSC_COPY_VALUES,&(mesh->ns)); CHKERRQ(ierr);
+    }
+    ierr = UMCheckElements(mesh); CHKERRQ(ierr);
+    ierr = UMCheckBoundaryData(mesh); CHKERRQ(ierr);
+    ierr = UMSetUpGhosts(mesh); CHKERRQ(ierr);
+    return 0;
+}
+
+/* Layout of a .umb file, written by petsc2umb.py:  this header, then arrays
+loc (2N PetscReal), e (3K PetscInt), bf (N PetscInt), and ns (2P PetscInt;
+absent if P=0) at the given byte offsets, each a multiple of 64.  The file is
+in native byte order and the integer and real sizes are recorded so that a
+mismatched file is rejected instead of misread. */
+#define UM_MAPPED_VERSION 1
+typedef struct {
+    char     magic[8];      // "PETSCUM" plus terminating zero
+    int32_t  version,       // UM_MAPPED_VERSION
+             byteorder,     // 0x01020304 as written
+             intsize,       // sizeof(PetscInt)
+             realsize;      // sizeof(PetscReal)
+    int64_t  N, K, P,
+             offloc, offe, offbf, offns;
+} UMMappedHeader;
+
+PetscErrorCode UMReadMapped(UM *mesh, char *filename) {
+    PetscErrorCode ierr;
+    PetscMPIInt    size;
+    int            fd;
+    struct stat    st;
+    char           *base;
+    UMMappedHeader hdr;
+    PetscReal      *aloc;
+    PetscInt       *ae, *abf, *ans, n, kstart, nstart, pstart, *idx;
+
+    if ((mesh->N > 0) || (mesh->loc) || (mesh->e)) {
+        SETERRQ(PETSC_COMM_SELF,1,"mesh already read?\n");
+    }
+    fd = open(filename,O_RDONLY);
+    if (fd < 0) {
+        SETERRQ1(PETSC_COMM_SELF,2,"could not open mesh file %s\n",filename);
+    }
+    if (fstat(fd,&st) != 0) {
+        close(fd);
+        SETERRQ1(PETSC_COMM_SELF,2,"could not stat mesh file %s\n",filename);
+    }
+    if ((size_t)st.st_size < sizeof(UMMappedHeader)) {
+        close(fd);
+        SETERRQ1(PETSC_COMM_SELF,3,"mesh file %s too short for header\n",filename);
+    }
+    // private, writable mapping:  pages are copy-on-write, so in-place
+    //   changes to loc, e, bf, ns never reach the file
+    base = (char*)mmap(NULL,(size_t)st.st_size,PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE,fd,0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        SETERRQ1(PETSC_COMM_SELF,2,"mmap() of mesh file %s failed\n",filename);
+    }
+    mesh->map = base;
+    mesh->maplen = (size_t)st.st_size;
+
+    // check header
+    ierr = PetscMemcpy(&hdr,base,sizeof(UMMappedHeader)); CHKERRQ(ierr);
+    if (strncmp(hdr.magic,"PETSCUM",8) != 0) {
+        SETERRQ1(PETSC_COMM_SELF,3,"%s is not a .umb mesh file\n",filename);
+    }
+    if (hdr.version != UM_MAPPED_VERSION) {
+        SETERRQ3(PETSC_COMM_SELF,3,"%s has format version %d; expected %d\n",
+                 filename,(int)hdr.version,UM_MAPPED_VERSION);
+    }
+    if (hdr.byteorder != 0x01020304) {
+        SETERRQ1(PETSC_COMM_SELF,3,"%s was written with other byte order\n",filename);
+    }
+    if ((hdr.intsize != (int32_t)sizeof(PetscInt))
+            || (hdr.realsize != (int32_t)sizeof(PetscReal))) {
+        SETERRQ1(PETSC_COMM_SELF,3,
+                 "%s has integer or real size not matching this PETSc build\n",filename);
+    }
+    if ((hdr.N <= 0) || (hdr.K <= 0) || (hdr.P < 0)
+            || (hdr.offloc % 64 != 0) || (hdr.offe % 64 != 0)
+            || (hdr.offbf % 64 != 0) || (hdr.offns % 64 != 0)
+            || ((size_t)hdr.offloc + 2*hdr.N*sizeof(PetscReal) > mesh->maplen)
+            || ((size_t)hdr.offe + 3*hdr.K*sizeof(PetscInt) > mesh->maplen)
+            || ((size_t)hdr.offbf + hdr.N*sizeof(PetscInt) > mesh->maplen)
+            || ((size_t)hdr.offns + 2*hdr.P*sizeof(PetscInt) > mesh->maplen)) {
+        SETERRQ1(PETSC_COMM_SELF,4,"header of %s inconsistent with file size\n",filename);
+    }
+    mesh->N = (PetscInt)hdr.N;
+    mesh->K = (PetscInt)hdr.K;
+    mesh->P = (PetscInt)hdr.P;
+    aloc = (PetscReal*)(base + hdr.offloc);
+    ae = (PetscInt*)(base + hdr.offe);
+    abf = (PetscInt*)(base + hdr.offbf);
+    ans = (mesh->P > 0) ? (PetscInt*)(base + hdr.offns) : NULL;
+
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    if (size == 1) {
+        // wrap the mapping; no copies
+        mesh->Nown = mesh->N;
+        mesh->Kown = mesh->K;
+        mesh->Pown = mesh->P;
+        ierr = VecCreateGhostBlockWithArray(PETSC_COMM_WORLD,2,2*mesh->N,2*mesh->N,
+                   0,NULL,aloc,&(mesh->loc)); CHKERRQ(ierr);
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,3*mesh->K,ae,
+                   PETSC_USE_POINTER,&(mesh->e)); CHKERRQ(ierr);
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,mesh->N,abf,
+                   PETSC_USE_POINTER,&(mesh->bf)); CHKERRQ(ierr);
+        if (mesh->P > 0) {
+            ierr = ISCreateGeneral(PETSC_COMM_SELF,2*mesh->P,ans,
+                       PETSC_USE_POINTER,&(mesh->ns)); CHKERRQ(ierr);
+        }
+        ierr = UMCheckElements(mesh); CHKERRQ(ierr);
+        ierr = UMCheckBoundaryData(mesh); CHKERRQ(ierr);
+        mesh->Ngh = 0;
+        ierr = PetscMalloc1(mesh->N,&idx); CHKERRQ(ierr);
+        for (n = 0; n < mesh->N; n++)
+            idx[n] = n;
+        ierr = ISLocalToGlobalMappingCreate(PETSC_COMM_WORLD,1,mesh->N,idx,
+                   PETSC_OWN_POINTER,&(mesh->ltog)); CHKERRQ(ierr);
+        return 0;
+    }
+
+    // in parallel copy contiguous chunks, as from UMReadNodes() and
+    //   UMReadISs(), then distribute
+    ierr = UMSplitOwnership(mesh,&nstart,&kstart,&pstart); CHKERRQ(ierr);
+    ierr = UMCreateFromChunks(mesh,aloc+2*nstart,ae+3*kstart,abf+nstart,
+                              (ans) ? ans+2*pstart : NULL); CHKERRQ(ierr);
+    if (munmap(mesh->map,mesh->maplen) != 0) {
+        SETERRQ(PETSC_COMM_SELF,1,"munmap() of mesh file failed\n");
+    }
+    mesh->map = NULL;
+    mesh->maplen = 0;
+    return 0;
+}
+
+/* Reader for Gmsh MSH 4.1 files, ASCII or binary; see
+   http://gmsh.info/doc/texinfo/gmsh.html#MSH-file-format
+Physical groups are identified by their names in $PhysicalNames, which must
+include "dirichlet", "neumann" and "interior", as in msh2petsc.py.  Nodes of
+line elements in a "dirichlet" curve get bf = 2, those in a "neumann" curve
+get bf = 1 (Dirichlet wins), and "neumann" line elements are Neumann segments.
+All triangles are elements.  Node tags must be 1,...,N in file order.  The
+file is read in one pass on rank 0 and then scattered. */
+
+typedef struct {
+    FILE      *f;
+    PetscBool binary;
+} GmshFile;
+
+static PetscErrorCode GmshReadSizeT(GmshFile *g, size_t *v) {
+    int ok;
+    if (g->binary)
+        ok = (fread(v,sizeof(size_t),1,g->f) == 1);
+    else
+        ok = (fscanf(g->f,"%zu",v) == 1);
+    if (!ok) {
+        SETERRQ(PETSC_COMM_SELF,3,"unexpected end of data in Gmsh file\n");
+    }
+    return 0;
+}
+
+static PetscErrorCode GmshReadInt(GmshFile *g, int *v) {
+    int ok;
+    if (g->binary)
+        ok = (fread(v,sizeof(int),1,g->f) == 1);
+    else
+        ok = (fscanf(g->f,"%d",v) == 1);
+    if (!ok) {
+        SETERRQ(PETSC_COMM_SELF,3,"unexpected end of data in Gmsh file\n");
+    }
+    return 0;
+}
+
+static PetscErrorCode GmshReadDoubles(GmshFile *g, size_t n, double *v) {
+    size_t j;
+    if (g->binary) {
+        if (fread(v,sizeof(double),n,g->f) != n) {
+            SETERRQ(PETSC_COMM_SELF,3,"unexpected end of data in Gmsh file\n");
+        }
+        return 0;
+    }
+    for (j = 0; j < n; j++) {
+        if (fscanf(g->f,"%lf",&(v[j])) != 1) {
+            SETERRQ(PETSC_COMM_SELF,3,"unexpected end of data in Gmsh file\n");
+        }
+    }
+    return 0;
+}
+
+// read lines until one which, with whitespace trimmed, equals tag
+static PetscErrorCode GmshSkipTo(GmshFile *g, const char *tag) {
+    char line[256], *t;
+    size_t len;
+    while (fgets(line,sizeof(line),g->f)) {
+        t = line;
+        while (isspace((unsigned char)*t))
+            t++;
+        len = strlen(t);
+        while ((len > 0) && isspace((unsigned char)t[len-1]))
+            t[--len] = '\0';
+        if (strcmp(t,tag) == 0)
+            return 0;
+    }
+    SETERRQ1(PETSC_COMM_SELF,3,"%s not found in Gmsh file\n",tag);
+}
+
+// skip one entity (point, curve, or surface) in $Entities; if a physical
+//   tag is present then return the first one, otherwise -1
+static PetscErrorCode GmshReadEntity(GmshFile *g, PetscBool ispoint,
+                                     int *tag, int *phys) {
+    PetscErrorCode ierr;
+    double box[6];
+    size_t nphys, nbound, j;
+    int    dummy;
+    ierr = GmshReadInt(g,tag); CHKERRQ(ierr);
+    ierr = GmshReadDoubles(g,ispoint ? 3 : 6,box); CHKERRQ(ierr);
+    ierr = GmshReadSizeT(g,&nphys); CHKERRQ(ierr);
+    *phys = -1;
+    for (j = 0; j < nphys; j++) {
+        ierr = GmshReadInt(g,&dummy); CHKERRQ(ierr);
+        if (j == 0)
+            *phys = dummy;
+    }
+    if (!ispoint) {
+        ierr = GmshReadSizeT(g,&nbound); CHKERRQ(ierr);
+        for (j = 0; j < nbound; j++) {
+            ierr = GmshReadInt(g,&dummy); CHKERRQ(ierr);
+        }
+    }
+    return 0;
+}
+
+// rank 0 only:  parse whole file into newly-allocated arrays
+static PetscErrorCode GmshParse(const char *filename, PetscInt *N,
+        PetscInt *K, PetscInt *P, PetscReal **xy, PetscInt **e,
+        PetscInt **bf, PetscInt **ns) {
+    PetscErrorCode ierr;
+    GmshFile  g;
+    char      line[256], version[16], name[256];
+    int       filetype, datasize, one, dim, tag, phys, etype, parametric,
+              dirichlet = -1, neumann = -1, interior = -1;
+    size_t    nnames, npts, ncurves, nsurfs, nvols, nblocks, ntot, nblk,
+              mintag, maxtag, ntag, etag, nodes[3], j, b;
+    double    xyz[3];
+    PetscInt  *curvetag = NULL, *curveflag = NULL, ncurvetags = 0, nn,
+              nen, Kcap = 0, Pcap = 0, flag, idx, m, l;
+    PetscBool haveformat = PETSC_FALSE, havenames = PETSC_FALSE,
+              haveentities = PETSC_FALSE, havenodes = PETSC_FALSE;
+
+    *N = 0;  *K = 0;  *P = 0;
+    *xy = NULL;  *e = NULL;  *bf = NULL;  *ns = NULL;
+    g.f = fopen(filename,"rb");
+    if (!g.f) {
+        SETERRQ1(PETSC_COMM_SELF,2,"could not open Gmsh file %s\n",filename);
+    }
+    g.binary = PETSC_FALSE;
+    while (fscanf(g.f,"%255s",line) == 1) {
+        if (strcmp(line,"$MeshFormat") == 0) {
+            if (fscanf(g.f,"%15s %d %d",version,&filetype,&datasize) != 3) {
+                SETERRQ1(PETSC_COMM_SELF,3,"bad $MeshFormat in %s\n",filename);
+            }
+            if (strcmp(version,"4.1") != 0) {
+                SETERRQ2(PETSC_COMM_SELF,3,
+                         "Gmsh format version %s in %s not supported; need 4.1\n",
+                         version,filename);
+            }
+            if (datasize != (int)sizeof(size_t)) {
+                SETERRQ1(PETSC_COMM_SELF,3,"data size %d in Gmsh file not supported\n",datasize);
+            }
+            g.binary = (filetype == 1) ? PETSC_TRUE : PETSC_FALSE;
+            if (g.binary) {  // after end of line: int 1 in writer's byte order
+                while (fgetc(g.f) != '\n')
+                    ;
+                if ((fread(&one,sizeof(int),1,g.f) != 1) || (one != 1)) {
+                    SETERRQ1(PETSC_COMM_SELF,3,
+                             "binary Gmsh file %s has other byte order\n",filename);
+                }
+            }
+            ierr = GmshSkipTo(&g,"$EndMeshFormat"); CHKERRQ(ierr);
+            haveformat = PETSC_TRUE;
+        } else if (strcmp(line,"$PhysicalNames") == 0) {
+            // always ASCII
+            if (fscanf(g.f,"%zu",&nnames) != 1) {
+                SETERRQ1(PETSC_COMM_SELF,3,"bad $PhysicalNames in %s\n",filename);
+            }
+            for (j = 0; j < nnames; j++) {
+                if (fscanf(g.f," %d %d \"%255[^\"]\"",&dim,&tag,name) != 3) {
+                    SETERRQ1(PETSC_COMM_SELF,3,"bad $PhysicalNames in %s\n",filename);
+                }
+                for (l = 0; name[l]; l++)
+                    name[l] = (char)tolower((unsigned char)name[l]);
+                if (strcmp(name,"dirichlet") == 0)
+                    dirichlet = tag;
+                else if (strcmp(name,"neumann") == 0)
+                    neumann = tag;
+                else if (strcmp(name,"interior") == 0)
+                    interior = tag;
+            }
+            if ((dirichlet < 0) || (neumann < 0) || (interior < 0)) {
+                SETERRQ1(PETSC_COMM_SELF,4,
+                         "physical names dirichlet, neumann, interior not all present in %s\n",filename);
+            }
+            ierr = GmshSkipTo(&g,"$EndPhysicalNames"); CHKERRQ(ierr);
+            havenames = PETSC_TRUE;
+        } else if (strcmp(line,"$Entities") == 0) {
+            if (!haveformat) {
+                SETERRQ1(PETSC_COMM_SELF,3,"$Entities before $MeshFormat in %s\n",filename);
+            }
+            if (g.binary)
+                fgetc(g.f);  // newline after section name
+            ierr = GmshReadSizeT(&g,&npts); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&ncurves); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&nsurfs); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&nvols); CHKERRQ(ierr);
+            if (nvols != 0) {
+                SETERRQ1(PETSC_COMM_SELF,4,"expected zero volume entities in %s\n",filename);
+            }
+            for (j = 0; j < npts; j++) {
+                ierr = GmshReadEntity(&g,PETSC_TRUE,&tag,&phys); CHKERRQ(ierr);
+            }
+            // boundary flag for each curve entity
+            ierr = PetscMalloc2(ncurves,&curvetag,ncurves,&curveflag); CHKERRQ(ierr);
+            for (j = 0; j < ncurves; j++) {
+                ierr = GmshReadEntity(&g,PETSC_FALSE,&tag,&phys); CHKERRQ(ierr);
+                curvetag[j] = tag;
+                curveflag[j] = (phys == dirichlet) ? 2 : ((phys == neumann) ? 1 : 0);
+            }
+            ncurvetags = (PetscInt)ncurves;
+            ierr = PetscSortIntWithArray(ncurvetags,curvetag,curveflag); CHKERRQ(ierr);
+            for (j = 0; j < nsurfs; j++) {
+                ierr = GmshReadEntity(&g,PETSC_FALSE,&tag,&phys); CHKERRQ(ierr);
+            }
+            ierr = GmshSkipTo(&g,"$EndEntities"); CHKERRQ(ierr);
+            haveentities = PETSC_TRUE;
+        } else if (strcmp(line,"$Nodes") == 0) {
+            if (!haveformat) {
+                SETERRQ1(PETSC_COMM_SELF,3,"$Nodes before $MeshFormat in %s\n",filename);
+            }
+            if (g.binary)
+                fgetc(g.f);
+            ierr = GmshReadSizeT(&g,&nblocks); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&ntot); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&mintag); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&maxtag); CHKERRQ(ierr);
+            *N = (PetscInt)ntot;
+            ierr = PetscMalloc1(2*(*N),xy); CHKERRQ(ierr);
+            ierr = PetscCalloc1(*N,bf); CHKERRQ(ierr);  // zero for interior
+            nn = 0;
+            for (b = 0; b < nblocks; b++) {
+                ierr = GmshReadInt(&g,&dim); CHKERRQ(ierr);
+                ierr = GmshReadInt(&g,&tag); CHKERRQ(ierr);
+                ierr = GmshReadInt(&g,&parametric); CHKERRQ(ierr);
+                ierr = GmshReadSizeT(&g,&nblk); CHKERRQ(ierr);
+                if (parametric != 0) {
+                    SETERRQ1(PETSC_COMM_SELF,4,"parametric nodes not supported in %s\n",filename);
+                }
+                if (nblk > ntot - (size_t)nn) {
+                    SETERRQ1(PETSC_COMM_SELF,4,"too many nodes in %s\n",filename);
+                }
+                for (j = 0; j < nblk; j++) {
+                    ierr = GmshReadSizeT(&g,&ntag); CHKERRQ(ierr);
+                    if (ntag != (size_t)nn + j + 1) {
+                        SETERRQ1(PETSC_COMM_SELF,4,
+                                 "node tags in %s are not 1,2,3,...\n",filename);
+                    }
+                }
+                for (j = 0; j < nblk; j++) {
+                    ierr = GmshReadDoubles(&g,3,xyz); CHKERRQ(ierr);  // ignore z
+                    (*xy)[2*nn+0] = xyz[0];
+                    (*xy)[2*nn+1] = xyz[1];
+                    nn++;
+                }
+            }
+            if (nn != *N) {
+                SETERRQ1(PETSC_COMM_SELF,4,"node count wrong in %s\n",filename);
+            }
+            ierr = GmshSkipTo(&g,"$EndNodes"); CHKERRQ(ierr);
+            havenodes = PETSC_TRUE;
+        } else if (strcmp(line,"$Elements") == 0) {
+            if (!(havenames && haveentities && havenodes)) {
+                SETERRQ1(PETSC_COMM_SELF,3,
+                         "$Elements before $PhysicalNames, $Entities, $Nodes in %s\n",filename);
+            }
+            if (g.binary)
+                fgetc(g.f);
+            ierr = GmshReadSizeT(&g,&nblocks); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&ntot); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&mintag); CHKERRQ(ierr);
+            ierr = GmshReadSizeT(&g,&maxtag); CHKERRQ(ierr);
+            for (b = 0; b < nblocks; b++) {
+                ierr = GmshReadInt(&g,&dim); CHKERRQ(ierr);
+                ierr = GmshReadInt(&g,&tag); CHKERRQ(ierr);
+                ierr = GmshReadInt(&g,&etype); CHKERRQ(ierr);
+                ierr = GmshReadSizeT(&g,&nblk); CHKERRQ(ierr);
+                switch (etype) {
+                    case 15: nen = 1; break;  // point
+                    case 1:  nen = 2; break;  // line segment
+                    case 2:  nen = 3; break;  // triangle
+                    default:
+                        SETERRQ2(PETSC_COMM_SELF,4,
+                                 "element type %d in %s not supported\n",etype,filename);
+                }
+                flag = 0;
+                if (etype == 1) {
+                    ierr = PetscFindInt(tag,ncurvetags,curvetag,&idx); CHKERRQ(ierr);
+                    if (idx < 0) {
+                        SETERRQ2(PETSC_COMM_SELF,4,"curve %d not in $Entities of %s\n",
+                                 tag,filename);
+                    }
+                    flag = curveflag[idx];
+                }
+                // grow element and segment arrays by whole blocks
+                if ((etype == 2) && (*K + (PetscInt)nblk > Kcap)) {
+                    Kcap = PetscMax(2*Kcap,*K + (PetscInt)nblk);
+                    ierr = PetscRealloc(3*Kcap*sizeof(PetscInt),e); CHKERRQ(ierr);
+                }
+                if ((flag == 1) && (*P + (PetscInt)nblk > Pcap)) {
+                    Pcap = PetscMax(2*Pcap,*P + (PetscInt)nblk);
+                    ierr = PetscRealloc(2*Pcap*sizeof(PetscInt),ns); CHKERRQ(ierr);
+                }
+                for (j = 0; j < nblk; j++) {
+                    ierr = GmshReadSizeT(&g,&etag); CHKERRQ(ierr);
+                    for (m = 0; m < nen; m++) {
+                        ierr = GmshReadSizeT(&g,&(nodes[m])); CHKERRQ(ierr);
+                        if ((nodes[m] < 1) || (nodes[m] > (size_t)(*N))) {
+                            SETERRQ1(PETSC_COMM_SELF,4,
+                                     "element node tag out of range in %s\n",filename);
+                        }
+                    }
+                    if (etype == 2) {
+                        for (m = 0; m < 3; m++)
+                            (*e)[3*(*K)+m] = (PetscInt)nodes[m] - 1;
+                        (*K)++;
+                    } else if (etype == 1) {
+                        for (m = 0; m < 2; m++)  // Dirichlet=2 wins for nodes
+                            (*bf)[nodes[m]-1] = PetscMax((*bf)[nodes[m]-1],flag);
+                        if (flag == 1) {
+                            (*ns)[2*(*P)+0] = (PetscInt)nodes[0] - 1;
+                            (*ns)[2*(*P)+1] = (PetscInt)nodes[1] - 1;
+                            (*P)++;
+                        }
+                    }
+                }
+            }
+            ierr = GmshSkipTo(&g,"$EndElements"); CHKERRQ(ierr);
+        } else if (line[0] == '$') {  // skip unused section
+            char endtag[260] = "$End";
+            strncat(endtag,line+1,sizeof(endtag)-5);
+            ierr = GmshSkipTo(&g,endtag); CHKERRQ(ierr);
+        }
+    }
+    fclose(g.f);
+    ierr = PetscFree2(curvetag,curveflag); CHKERRQ(ierr);
+    if ((*N == 0) || (*K == 0)) {
+        SETERRQ1(PETSC_COMM_SELF,4,"no nodes or no triangles read from %s\n",filename);
+    }
     return 0;
 }
 
+PetscErrorCode UMReadGmsh(UM *mesh, char *filename) {
+    PetscErrorCode ierr;
+    PetscMPIInt    rank, size, j, *cnt = NULL, *disp = NULL;
+    PetscInt       N = 0, K = 0, P = 0, sizes[3], nstart, kstart, pstart,
+                   *e = NULL, *bf = NULL, *ns = NULL,
+                   *ael, *abfl, *ansl, nloc[3], *allnloc = NULL;
+    PetscReal      *xy = NULL, *alocl;
+
+    if ((mesh->N > 0) || (mesh->loc) || (mesh->e)) {
+        SETERRQ(PETSC_COMM_SELF,1,"mesh already read?\n");
+    }
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    if (rank == 0) {
+        ierr = GmshParse(filename,&N,&K,&P,&xy,&e,&bf,&ns); CHKERRQ(ierr);
+        sizes[0] = N;  sizes[1] = K;  sizes[2] = P;
+    }
+    ierr = MPI_Bcast(sizes,3,MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    mesh->N = sizes[0];
+    mesh->K = sizes[1];
+    mesh->P = sizes[2];
+    ierr = UMSplitOwnership(mesh,&nstart,&kstart,&pstart); CHKERRQ(ierr);
+    if (size == 1) {
+        ierr = UMCreateFromChunks(mesh,xy,e,bf,ns); CHKERRQ(ierr);
+        ierr = PetscFree(xy); CHKERRQ(ierr);
+        ierr = PetscFree(e); CHKERRQ(ierr);
+        ierr = PetscFree(bf); CHKERRQ(ierr);
+        ierr = PetscFree(ns); CHKERRQ(ierr);
+        return 0;
+    }
+
+    // scatter contiguous chunks from rank 0
+    nloc[0] = mesh->Nown;  nloc[1] = mesh->Kown;  nloc[2] = mesh->Pown;
+    if (rank == 0) {
+        ierr = PetscMalloc3(3*size,&allnloc,size,&cnt,size,&disp); CHKERRQ(ierr);
+    }
+    ierr = MPI_Gather(nloc,3,MPIU_INT,allnloc,3,MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = PetscMalloc4(2*mesh->Nown,&alocl,3*mesh->Kown,&ael,
+                        mesh->Nown,&abfl,2*mesh->Pown,&ansl); CHKERRQ(ierr);
+#define UMSCATTER(SRC,DST,TYPE,WHICH,DOF) \
+    if (rank == 0) { \
+        for (j = 0; j < size; j++) { \
+            cnt[j] = (PetscMPIInt)((DOF) * allnloc[3*j+(WHICH)]); \
+            disp[j] = (j == 0) ? 0 : disp[j-1] + cnt[j-1]; \
+        } \
+    } \
+    ierr = MPI_Scatterv(SRC,cnt,disp,TYPE,DST,(PetscMPIInt)((DOF)*nloc[WHICH]), \
+                        TYPE,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    UMSCATTER(xy,alocl,MPIU_REAL,0,2)
+    UMSCATTER(e,ael,MPIU_INT,1,3)
+    UMSCATTER(bf,abfl,MPIU_INT,0,1)
+    if (mesh->P > 0) {
+        UMSCATTER(ns,ansl,MPIU_INT,2,2)
+    }
+#undef UMSCATTER
+    ierr = UMCreateFromChunks(mesh,alocl,ael,abfl,
+                              (mesh->P > 0) ? ansl : NULL); CHKERRQ(ierr);
+    ierr = PetscFree4(alocl,ael,abfl,ansl); CHKERRQ(ierr);
+    if (rank == 0) {
+        ierr = PetscFree3(allnloc,cnt,disp); CHKERRQ(ierr);
+        ierr = PetscFree(xy); CHKERRQ(ierr);
+        ierr = PetscFree(e); CHKERRQ(ierr);
+        ierr = PetscFree(bf); CHKERRQ(ierr);
+        ierr = PetscFree(ns); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+
+/* Node (i,j) of the structured mesh is n = j*M + i, and cell (i,j) with
+lower-left node A = n(i,j) holds elements 2*(j*(M-1)+i) = (A,A+1,A+M) and
+2*(j*(M-1)+i)+1 = (A+1,A+M+1,A+M), as in genstructured.py.  Neumann segments
+run counterclockwise along the sides flagged in neumann[], in the order
+south, east, north, west. */
+PetscErrorCode UMCreateStructured(UM *mesh, PetscInt M, PetscInt N,
+                                  PetscReal Lx, PetscReal Ly,
+                                  const PetscBool *neumann) {
+    PetscErrorCode ierr;
+    const PetscInt side[4] = {M-1, N-1, M-1, N-1};
+    PetscInt       nstart, kstart, pstart, n, k, p, q, i, j, A, *ae, *abf,
+                   *ans, start[4], cnt = 0;
+    PetscReal      *aloc, hx, hy;
+    PetscBool      nside[4] = {PETSC_FALSE, PETSC_FALSE, PETSC_FALSE, PETSC_FALSE},
+                   onbdry, ondir;
+
+    if ((mesh->N > 0) || (mesh->loc) || (mesh->e)) {
+        SETERRQ(PETSC_COMM_SELF,1,"mesh already read?\n");
+    }
+    if ((M < 2) || (N < 2)) {
+        SETERRQ2(PETSC_COMM_SELF,2,"structured mesh needs M,N >= 2 nodes; got M=%d, N=%d\n",M,N);
+    }
+    if (neumann) {
+        for (q = 0; q < 4; q++)
+            nside[q] = neumann[q];
+    }
+    for (q = 0; q < 4; q++) {
+        start[q] = cnt;
+        if (nside[q])
+            cnt += side[q];
+    }
+    mesh->N = M * N;
+    mesh->K = 2 * (M-1) * (N-1);
+    mesh->P = cnt;
+    ierr = UMSplitOwnership(mesh,&nstart,&kstart,&pstart); CHKERRQ(ierr);
+    ierr = PetscMalloc4(2*mesh->Nown,&aloc,3*mesh->Kown,&ae,
+                        mesh->Nown,&abf,2*mesh->Pown,&ans); CHKERRQ(ierr);
+    hx = Lx / (M - 1);
+    hy = Ly / (N - 1);
+    for (n = 0; n < mesh->Nown; n++) {
+        i = (nstart + n) % M;
+        j = (nstart + n) / M;
+        aloc[2*n+0] = (i == M-1) ? Lx : i * hx;
+        aloc[2*n+1] = (j == N-1) ? Ly : j * hy;
+        onbdry = (j == 0) || (i == M-1) || (j == N-1) || (i == 0);
+        ondir =    ((j == 0) && !nside[0]) || ((i == M-1) && !nside[1])
+                || ((j == N-1) && !nside[2]) || ((i == 0) && !nside[3]);
+        abf[n] = ondir ? 2 : (onbdry ? 1 : 0);
+    }
+    for (k = 0; k < mesh->Kown; k++) {
+        q = (kstart + k) / 2;
+        A = (q / (M-1)) * M + q % (M-1);
+        if ((kstart + k) % 2 == 0) {
+            ae[3*k+0] = A;      ae[3*k+1] = A + 1;  ae[3*k+2] = A + M;
+        } else {
+            ae[3*k+0] = A + 1;  ae[3*k+1] = A + M + 1;  ae[3*k+2] = A + M;
+        }
+    }
+    for (p = 0; p < mesh->Pown; p++) {
+        for (q = 3; (q > 0) && ((!nside[q]) || (start[q] > pstart + p)); q--)
+            ;
+        i = pstart + p - start[q];
+        switch (q) {
+            case 0 :  // south, left to right
+                ans[2*p+0] = i;                    ans[2*p+1] = i + 1;
+                break;
+            case 1 :  // east, bottom to top
+                ans[2*p+0] = i * M + M - 1;        ans[2*p+1] = (i + 1) * M + M - 1;
+                break;
+            case 2 :  // north, right to left
+                ans[2*p+0] = (N-1) * M + M - 1 - i;  ans[2*p+1] = (N-1) * M + M - 2 - i;
+                break;
+            default : // west, top to bottom
+                ans[2*p+0] = (N - 1 - i) * M;      ans[2*p+1] = (N - 2 - i) * M;
+        }
+    }
+    ierr = UMCreateFromChunks(mesh,aloc,ae,abf,
+                              (mesh->P > 0) ? ans : NULL); CHKERRQ(ierr);
+    ierr = PetscFree4(aloc,ae,abf,ans); CHKERRQ(ierr);
+    return 0;
+}
 
 PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
                        PetscReal *maxa, PetscReal *meana) {
@@ -251,7 +1315,8 @@ PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
     const Node     *aloc;
     PetscInt       k;
     PetscReal      x[3], y[3], ax, ay, bx, by, cx, cy, h, a,
-                   Maxh = 0.0, Maxa = 0.0, Sumh = 0.0, Suma = 0.0;
+                   Maxh = 0.0, Maxa = 0.0, Sumh = 0.0, Suma = 0.0,
+                   locmax[2], globmax[2], locsum[2], globsum[2];
     if ((mesh->K == 0) || (mesh->e == NULL)) {
         SETERRQ(PETSC_COMM_SELF,1,
                 "number of elements unknown; call UMReadElements() first\n");
@@ -262,7 +1327,7 @@ PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
     }
     ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
     ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
-    for (k = 0; k < mesh->K; k++) {
+    for (k = 0; k < mesh->Kown; k++) {
         x[0] = aloc[ae[3*k]].x;
         y[0] = aloc[ae[3*k]].y;
         x[1] = aloc[ae[3*k+1]].x;
@@ -285,29 +1350,951 @@ PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
     }
     ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
     ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
-    if (maxh)  *maxh = Maxh;
-    if (maxa)  *maxa = Maxa;
-    if (meanh)  *meanh = Sumh / mesh->K;
-    if (meana)  *meana = Suma / mesh->K;
+    locmax[0] = Maxh;  locmax[1] = Maxa;
+    locsum[0] = Sumh;  locsum[1] = Suma;
+    ierr = MPI_Allreduce(locmax,globmax,2,MPIU_REAL,MPIU_MAX,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = MPI_Allreduce(locsum,globsum,2,MPIU_REAL,MPIU_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    if (maxh)  *maxh = globmax[0];
+    if (maxa)  *maxa = globmax[1];
+    if (meanh)  *meanh = globsum[0] / mesh->K;
+    if (meana)  *meana = globsum[1] / mesh->K;
     return 0;
 }
 
 PetscErrorCode UMGetNodeCoordArrayRead(UM *mesh, const Node **xy) {
     PetscErrorCode ierr;
+    Vec            locl;
     if ((!mesh->loc) || (mesh->N == 0)) {
         SETERRQ(PETSC_COMM_SELF,1,"node coordinates not created ... stopping\n");
     }
-    ierr = VecGetArrayRead(mesh->loc,(const PetscReal **)xy); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(mesh,mesh->loc,&locl); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(locl,(const PetscReal **)xy); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(mesh,mesh->loc,&locl); CHKERRQ(ierr);
     return 0;
 }
 
 
 PetscErrorCode UMRestoreNodeCoordArrayRead(UM *mesh, const Node **xy) {
     PetscErrorCode ierr;
+    Vec            locl;
     if ((!mesh->loc) || (mesh->N == 0)) {
         SETERRQ(PETSC_COMM_SELF,1,"node coordinates not created ... stopping\n");
     }
-    ierr = VecRestoreArrayRead(mesh->loc,(const PetscReal **)xy); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(mesh,mesh->loc,&locl); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(locl,(const PetscReal **)xy); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(mesh,mesh->loc,&locl); CHKERRQ(ierr);
+    return 0;
+}
+
+
+PetscErrorCode UMCreateGlobalVec(UM *mesh, Vec *v) {
+    PetscErrorCode ierr;
+    const PetscInt *ltogidx;
+    if (!mesh->ltog) {
+        SETERRQ(PETSC_COMM_SELF,1,"parallel layout not created; call UMReadISs() first\n");
+    }
+    ierr = ISLocalToGlobalMappingGetIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+    ierr = VecCreateGhost(PETSC_COMM_WORLD,mesh->Nown,mesh->N,mesh->Ngh,
+                          ltogidx + mesh->Nown,v); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingRestoreIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+    return 0;
+}
+
+
+PetscErrorCode UMVecGetLocalForm(UM *mesh, Vec v, Vec *vl) {
+    PetscErrorCode ierr;
+    PetscMPIInt    size;
+    ierr = VecGhostGetLocalForm(v,vl); CHKERRQ(ierr);
+    if (*vl == NULL) {
+        ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+        if (size > 1) {
+            SETERRQ(PETSC_COMM_SELF,1,
+                    "Vec is not ghosted; create it with UMCreateGlobalVec()\n");
+        }
+        // one process so global form is local form; reference is
+        //   removed by UMVecRestoreLocalForm()
+        ierr = PetscObjectReference((PetscObject)v); CHKERRQ(ierr);
+        *vl = v;
+    }
     return 0;
 }
 
+
+PetscErrorCode UMVecRestoreLocalForm(UM *mesh, Vec v, Vec *vl) {
+    PetscErrorCode ierr;
+    ierr = VecGhostRestoreLocalForm(v,vl); CHKERRQ(ierr);
+    *vl = NULL;
+    return 0;
+}
+
+
+PetscErrorCode UMVecGhostUpdate(UM *mesh, Vec v, InsertMode imode,
+                                ScatterMode smode) {
+    PetscErrorCode ierr;
+    PetscMPIInt    size;
+    Vec            vl;
+    ierr = VecGhostGetLocalForm(v,&vl); CHKERRQ(ierr);
+    if (vl == NULL) {
+        ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+        if (size > 1) {
+            SETERRQ(PETSC_COMM_SELF,1,
+                    "Vec is not ghosted; create it with UMCreateGlobalVec()\n");
+        }
+        return 0;  // nothing to update
+    }
+    ierr = VecGhostRestoreLocalForm(v,&vl); CHKERRQ(ierr);
+    ierr = VecGhostUpdateBegin(v,imode,smode); CHKERRQ(ierr);
+    ierr = VecGhostUpdateEnd(v,imode,smode); CHKERRQ(ierr);
+    return 0;
+}
+
+
+/* The gradients are computed by exactly the formulas in FormFunction() and
+FormPicard() in unfem.c, so cached and uncached assembly give identical
+results. */
+PetscErrorCode UMSetUpGeometryCache(UM *mesh,
+                                    PetscReal (*gD_fcn)(PetscReal, PetscReal)) {
+    PetscErrorCode ierr;
+    const PetscReal dchi[3][2] = {{-1.0,-1.0},{ 1.0, 0.0},{ 0.0, 1.0}};
+    const PetscInt  *ae, *abf, *en;
+    const Node      *aloc;
+    UMGeometryCache *g;
+    PetscReal       *block;
+    PetscInt        K = mesh->Kown, Nloc = mesh->Nown + mesh->Ngh, k, l, n;
+
+    if ((!mesh->e) || (!mesh->bf) || (!mesh->ltog)) {
+        SETERRQ(PETSC_COMM_SELF,1,"mesh not complete; call UMReadISs() first\n");
+    }
+    if (mesh->geom) {
+        SETERRQ(PETSC_COMM_SELF,2,"geometry cache already created\n");
+    }
+    ierr = PetscMalloc1(1,&g); CHKERRQ(ierr);
+    ierr = PetscMalloc1(13*K,&block); CHKERRQ(ierr);
+    g->x0 = block;
+    g->y0 = block + K;
+    g->dx1 = block + 2*K;
+    g->dx2 = block + 3*K;
+    g->dy1 = block + 4*K;
+    g->dy2 = block + 5*K;
+    g->detJ = block + 6*K;
+    for (l = 0; l < 3; l++) {
+        g->gx[l] = block + (7+2*l)*K;
+        g->gy[l] = block + (8+2*l)*K;
+    }
+    g->gD = NULL;
+
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (k = 0; k < K; k++) {
+        en = ae + 3*k;
+        g->x0[k] = aloc[en[0]].x;
+        g->y0[k] = aloc[en[0]].y;
+        g->dx1[k] = aloc[en[1]].x - aloc[en[0]].x;
+        g->dx2[k] = aloc[en[2]].x - aloc[en[0]].x;
+        g->dy1[k] = aloc[en[1]].y - aloc[en[0]].y;
+        g->dy2[k] = aloc[en[2]].y - aloc[en[0]].y;
+        g->detJ[k] = g->dx1[k] * g->dy2[k] - g->dx2[k] * g->dy1[k];
+        for (l = 0; l < 3; l++) {
+            g->gx[l][k] = ( g->dy2[k] * dchi[l][0] - g->dy1[k] * dchi[l][1]) / g->detJ[k];
+            g->gy[l][k] = (-g->dx2[k] * dchi[l][0] + g->dx1[k] * dchi[l][1]) / g->detJ[k];
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    if (gD_fcn) {
+        ierr = PetscMalloc1(Nloc,&(g->gD)); CHKERRQ(ierr);
+        ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+        for (n = 0; n < Nloc; n++)
+            g->gD[n] = (abf[n] == 2) ? gD_fcn(aloc[n].x,aloc[n].y) : 0.0;
+        ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    }
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    mesh->geom = g;
+    return 0;
+}
+
+
+/* Greedy coloring:  each element gets the smallest color not yet used at any
+of its nodes, tracked by a 64-bit mask per node.  For a triangulation in which
+at most d elements share a node, at most 3(d-1)+1 colors result, so 64 colors
+suffice for any reasonable mesh.  Elements keep their relative order within a
+color, which preserves locality from UMReorder(). */
+PetscErrorCode UMColorElements(UM *mesh) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *en;
+    uint64_t       *used, avail;
+    PetscInt       Nloc = mesh->Nown + mesh->Ngh, k, l, c, *color, *cnt;
+
+    if ((!mesh->e) || (!mesh->ltog)) {
+        SETERRQ(PETSC_COMM_SELF,1,"mesh not complete; call UMReadISs() first\n");
+    }
+    if (mesh->colorptr) {
+        SETERRQ(PETSC_COMM_SELF,2,"elements already colored\n");
+    }
+    ierr = PetscCalloc1(Nloc,&used); CHKERRQ(ierr);
+    ierr = PetscMalloc1(mesh->Kown,&color); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    mesh->ncolors = 0;
+    for (k = 0; k < mesh->Kown; k++) {
+        en = ae + 3*k;
+        avail = ~(used[en[0]] | used[en[1]] | used[en[2]]);
+        if (avail == 0) {
+            SETERRQ(PETSC_COMM_SELF,3,"more than 64 element colors needed\n");
+        }
+        for (c = 0; !((avail >> c) & 1); c++)
+            ;
+        color[k] = c;
+        for (l = 0; l < 3; l++)
+            used[en[l]] |= ((uint64_t)1) << c;
+        mesh->ncolors = PetscMax(mesh->ncolors,c+1);
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    // bucket elements by color
+    ierr = PetscMalloc2(mesh->ncolors+1,&(mesh->colorptr),
+                        mesh->Kown,&(mesh->colorelts)); CHKERRQ(ierr);
+    ierr = PetscCalloc1(mesh->ncolors+1,&cnt); CHKERRQ(ierr);
+    for (k = 0; k < mesh->Kown; k++)
+        cnt[color[k]+1]++;
+    mesh->colorptr[0] = 0;
+    for (c = 0; c < mesh->ncolors; c++)
+        mesh->colorptr[c+1] = mesh->colorptr[c] + cnt[c+1];
+    for (c = 0; c < mesh->ncolors; c++)
+        cnt[c] = mesh->colorptr[c];
+    for (k = 0; k < mesh->Kown; k++)
+        mesh->colorelts[cnt[color[k]]++] = k;
+    ierr = PetscFree(cnt); CHKERRQ(ierr);
+    ierr = PetscFree(color); CHKERRQ(ierr);
+    ierr = PetscFree(used); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMBuildAdjacency(UM *mesh) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *en;
+    PetscInt       Nloc = mesh->Nown + mesh->Ngh, n, k, l, j, m, *cnt, *last;
+
+    if ((!mesh->e) || (!mesh->ltog)) {
+        SETERRQ(PETSC_COMM_SELF,1,"mesh not complete; call UMReadISs() first\n");
+    }
+    if (mesh->eltptr) {
+        SETERRQ(PETSC_COMM_SELF,2,"adjacency already built\n");
+    }
+    // each element gives a node at most two neighbors, so 6 Kown bounds nbrs
+    ierr = PetscMalloc4(Nloc+1,&(mesh->eltptr),3*mesh->Kown,&(mesh->elts),
+                        Nloc+1,&(mesh->nbrptr),6*mesh->Kown,&(mesh->nbrs)); CHKERRQ(ierr);
+    ierr = PetscMalloc2(Nloc,&cnt,Nloc,&last); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    // node-to-element by counting then filling buckets
+    for (n = 0; n < Nloc; n++)
+        cnt[n] = 0;
+    for (k = 0; k < 3*mesh->Kown; k++)
+        cnt[ae[k]]++;
+    mesh->eltptr[0] = 0;
+    for (n = 0; n < Nloc; n++) {
+        mesh->eltptr[n+1] = mesh->eltptr[n] + cnt[n];
+        cnt[n] = mesh->eltptr[n];
+    }
+    for (k = 0; k < mesh->Kown; k++)
+        for (l = 0; l < 3; l++)
+            mesh->elts[cnt[ae[3*k+l]]++] = k;
+
+    // node-to-node from node-to-element; last[m] == n marks m as already
+    //   listed in row n
+    for (n = 0; n < Nloc; n++)
+        last[n] = -1;
+    mesh->nbrptr[0] = 0;
+    for (n = 0; n < Nloc; n++) {
+        last[n] = n;
+        m = mesh->nbrptr[n];
+        for (j = mesh->eltptr[n]; j < mesh->eltptr[n+1]; j++) {
+            en = ae + 3*mesh->elts[j];
+            for (l = 0; l < 3; l++) {
+                if (last[en[l]] != n) {
+                    last[en[l]] = n;
+                    mesh->nbrs[m++] = en[l];
+                }
+            }
+        }
+        mesh->nbrptr[n+1] = m;
+        ierr = PetscSortInt(m - mesh->nbrptr[n],
+                            mesh->nbrs + mesh->nbrptr[n]); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = PetscFree2(cnt,last); CHKERRQ(ierr);
+    return 0;
+}
+
+
+// index along a Hilbert curve of cell (x,y) in a 2^order x 2^order grid
+static PetscInt HilbertIndex(PetscInt order, PetscInt x, PetscInt y) {
+    const PetscInt n = 1 << order;
+    PetscInt rx, ry, s, d = 0, t;
+    for (s = n / 2; s > 0; s /= 2) {
+        rx = (x & s) > 0;
+        ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {  // rotate quadrant
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            t = x;  x = y;  y = t;
+        }
+    }
+    return d;
+}
+
+// perm[i] = old index of new node i, by reverse Cuthill-McKee applied to
+//   the node-node adjacency graph of the N nodes and K element triples e
+static PetscErrorCode NodeOrderingRCM(PetscInt N, PetscInt K, const PetscInt *e,
+                                      PetscInt *perm) {
+    PetscErrorCode ierr;
+    const PetscInt  *en, *arperm;
+    const PetscReal one[9] = {1.0,1.0,1.0,1.0,1.0,1.0,1.0,1.0,1.0};
+    PetscInt        *nnz, n, k, l;
+    Mat             A;
+    IS              rperm, cperm;
+    ierr = PetscMalloc1(N,&nnz); CHKERRQ(ierr);
+    for (n = 0; n < N; n++)
+        nnz[n] = 1;
+    for (k = 0; k < K; k++)
+        for (l = 0; l < 3; l++)
+            nnz[e[3*k+l]] += 2;
+    ierr = MatCreateSeqAIJ(PETSC_COMM_SELF,N,N,0,nnz,&A); CHKERRQ(ierr);
+    ierr = PetscFree(nnz); CHKERRQ(ierr);
+    for (k = 0; k < K; k++) {
+        en = e + 3*k;
+        ierr = MatSetValues(A,3,en,3,en,one,INSERT_VALUES); CHKERRQ(ierr);
+    }
+    ierr = MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatGetOrdering(A,MATORDERINGRCM,&rperm,&cperm); CHKERRQ(ierr);
+    ierr = ISGetIndices(rperm,&arperm); CHKERRQ(ierr);
+    ierr = PetscArraycpy(perm,arperm,N); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(rperm,&arperm); CHKERRQ(ierr);
+    ierr = ISDestroy(&rperm); CHKERRQ(ierr);
+    ierr = ISDestroy(&cperm); CHKERRQ(ierr);
+    ierr = MatDestroy(&A); CHKERRQ(ierr);
+    return 0;
+}
+
+// perm[i] = old index of new node i, by sorting on the Hilbert index of
+//   each of the N nodes xy within the bounding box
+static PetscErrorCode NodeOrderingHilbert(PetscInt N, const Node *xy,
+                                          PetscInt *perm) {
+    PetscErrorCode ierr;
+    const PetscInt order = 15;  // 2^30 cells; index fits in 32 bit PetscInt
+    PetscInt       *key, n, ix, iy;
+    PetscReal      xmin, xmax, ymin, ymax, scale;
+    xmin = xmax = xy[0].x;
+    ymin = ymax = xy[0].y;
+    for (n = 1; n < N; n++) {
+        xmin = PetscMin(xmin,xy[n].x);  xmax = PetscMax(xmax,xy[n].x);
+        ymin = PetscMin(ymin,xy[n].y);  ymax = PetscMax(ymax,xy[n].y);
+    }
+    scale = ((1 << order) - 1) / PetscMax(PetscMax(xmax - xmin, ymax - ymin),
+                                          PETSC_MACHINE_EPSILON);
+    ierr = PetscMalloc1(N,&key); CHKERRQ(ierr);
+    for (n = 0; n < N; n++) {
+        ix = (PetscInt)(scale * (xy[n].x - xmin));
+        iy = (PetscInt)(scale * (xy[n].y - ymin));
+        key[n] = HilbertIndex(order,ix,iy);
+        perm[n] = n;
+    }
+    ierr = PetscSortIntWithPermutation(N,key,perm); CHKERRQ(ierr);
+    ierr = PetscFree(key); CHKERRQ(ierr);
+    return 0;
+}
+
+/* The ordering is of the whole mesh, so the owned chunks, in global node
+indices, are gathered to rank 0, which computes the ordering, renumbers the
+nodes, and sorts the elements by their minimum new node.  Then contiguous
+chunks of the reordered mesh are scattered, as in UMReadGmsh(), and the ghosts
+are rebuilt.  Thus on P processes each owns a block of the *new* numbering,
+a compact piece of the mesh, with the elements around it, instead of a block of
+the file numbering.  Rank 0 holds the whole mesh during the call. */
+PetscErrorCode UMReorder(UM *mesh, UMReorderType type) {
+    PetscErrorCode  ierr;
+    PetscMPIInt     rank, size, j, *cnt = NULL, *disp = NULL;
+    const PetscInt  *ae, *abf, *ans;
+    const PetscReal *aloc;
+    PetscInt        nloc[3], *allnloc = NULL, nstart, kstart, pstart,
+                    *eg, *nsg, *e = NULL, *bf = NULL, *ns = NULL,
+                    *perm = NULL, *iperm, *emin, *eperm,
+                    *newe = NULL, *newbf = NULL, *newns = NULL,
+                    *ael, *abfl, *ansl, *aperml, n, k, m;
+    PetscReal       *xy = NULL, *newxy = NULL, *alocl;
+
+    if (type == REORDER_NONE)
+        return 0;
+    if ((type != REORDER_RCM) && (type != REORDER_HILBERT)) {
+        SETERRQ(PETSC_COMM_SELF,4,"unknown UMReorderType\n");
+    }
+    if ((!mesh->e) || (!mesh->bf) || (!mesh->ltog)) {
+        SETERRQ(PETSC_COMM_SELF,2,"mesh not complete; call UMReadISs() first\n");
+    }
+    if (mesh->perm || mesh->geom || mesh->colorptr || mesh->ee || mesh->eltptr) {
+        SETERRQ(PETSC_COMM_SELF,3,
+                "mesh already reordered, or geometry cache, coloring, edges or adjacency already created\n");
+    }
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+
+    // gather owned chunks to rank 0; they are contiguous in rank order
+#define UMCOUNTS(WHICH,DOF) \
+    if (rank == 0) { \
+        for (j = 0; j < size; j++) { \
+            cnt[j] = (PetscMPIInt)((DOF) * allnloc[3*j+(WHICH)]); \
+            disp[j] = (j == 0) ? 0 : disp[j-1] + cnt[j-1]; \
+        } \
+    }
+    nloc[0] = mesh->Nown;  nloc[1] = mesh->Kown;  nloc[2] = mesh->Pown;
+    if (rank == 0) {
+        ierr = PetscMalloc3(3*size,&allnloc,size,&cnt,size,&disp); CHKERRQ(ierr);
+        ierr = PetscMalloc4(2*mesh->N,&xy,3*mesh->K,&e,
+                            mesh->N,&bf,2*mesh->P,&ns); CHKERRQ(ierr);
+    }
+    ierr = MPI_Gather(nloc,3,MPIU_INT,allnloc,3,MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = PetscMalloc2(3*mesh->Kown,&eg,2*mesh->Pown,&nsg); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingApply(mesh->ltog,3*mesh->Kown,ae,eg); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        ierr = ISLocalToGlobalMappingApply(mesh->ltog,2*mesh->Pown,ans,nsg); CHKERRQ(ierr);
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = VecGetArrayRead(mesh->loc,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    UMCOUNTS(0,2)
+    ierr = MPI_Gatherv(aloc,(PetscMPIInt)(2*nloc[0]),MPIU_REAL,
+                       xy,cnt,disp,MPIU_REAL,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    UMCOUNTS(1,3)
+    ierr = MPI_Gatherv(eg,(PetscMPIInt)(3*nloc[1]),MPIU_INT,
+                       e,cnt,disp,MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    UMCOUNTS(0,1)
+    ierr = MPI_Gatherv(abf,(PetscMPIInt)nloc[0],MPIU_INT,
+                       bf,cnt,disp,MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        UMCOUNTS(2,2)
+        ierr = MPI_Gatherv(nsg,(PetscMPIInt)(2*nloc[2]),MPIU_INT,
+                           ns,cnt,disp,MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(mesh->loc,&aloc); CHKERRQ(ierr);
+    ierr = PetscFree2(eg,nsg); CHKERRQ(ierr);
+
+    if (rank == 0) {
+        // node permutation (new to old) and its inverse (old to new)
+        ierr = PetscMalloc1(mesh->N,&perm); CHKERRQ(ierr);
+        if (type == REORDER_RCM) {
+            ierr = NodeOrderingRCM(mesh->N,mesh->K,e,perm); CHKERRQ(ierr);
+        } else {
+            ierr = NodeOrderingHilbert(mesh->N,(Node*)xy,perm); CHKERRQ(ierr);
+        }
+        ierr = PetscMalloc3(mesh->N,&iperm,mesh->K,&emin,mesh->K,&eperm); CHKERRQ(ierr);
+        for (n = 0; n < mesh->N; n++)
+            iperm[perm[n]] = n;
+        ierr = PetscMalloc4(2*mesh->N,&newxy,3*mesh->K,&newe,
+                            mesh->N,&newbf,2*mesh->P,&newns); CHKERRQ(ierr);
+        // node coordinates and boundary flags
+        for (n = 0; n < mesh->N; n++) {
+            newxy[2*n+0] = xy[2*perm[n]+0];
+            newxy[2*n+1] = xy[2*perm[n]+1];
+            newbf[n] = bf[perm[n]];
+        }
+        // elements: renumber nodes, then sort by minimum node
+        for (k = 0; k < mesh->K; k++) {
+            emin[k] = PetscMin(iperm[e[3*k]],PetscMin(iperm[e[3*k+1]],iperm[e[3*k+2]]));
+            eperm[k] = k;
+        }
+        ierr = PetscSortIntWithPermutation(mesh->K,emin,eperm); CHKERRQ(ierr);
+        for (k = 0; k < mesh->K; k++)
+            for (m = 0; m < 3; m++)
+                newe[3*k+m] = iperm[e[3*eperm[k]+m]];
+        // Neumann segments
+        for (n = 0; n < 2*mesh->P; n++)
+            newns[n] = iperm[ns[n]];
+        ierr = PetscFree3(iperm,emin,eperm); CHKERRQ(ierr);
+        ierr = PetscFree4(xy,e,bf,ns); CHKERRQ(ierr);
+    }
+
+    // replace the mesh by contiguous chunks of the reordered mesh
+    ierr = VecDestroy(&(mesh->loc)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->bf)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->ns)); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingDestroy(&(mesh->ltog)); CHKERRQ(ierr);
+    mesh->Ngh = 0;
+    ierr = UMSplitOwnership(mesh,&nstart,&kstart,&pstart); CHKERRQ(ierr);
+    nloc[0] = mesh->Nown;  nloc[1] = mesh->Kown;  nloc[2] = mesh->Pown;
+    ierr = MPI_Gather(nloc,3,MPIU_INT,allnloc,3,MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = PetscMalloc4(2*mesh->Nown,&alocl,3*mesh->Kown,&ael,
+                        mesh->Nown,&abfl,2*mesh->Pown,&ansl); CHKERRQ(ierr);
+    ierr = PetscMalloc1(mesh->Nown,&aperml); CHKERRQ(ierr);
+    UMCOUNTS(0,2)
+    ierr = MPI_Scatterv(newxy,cnt,disp,MPIU_REAL,alocl,(PetscMPIInt)(2*nloc[0]),
+                        MPIU_REAL,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    UMCOUNTS(1,3)
+    ierr = MPI_Scatterv(newe,cnt,disp,MPIU_INT,ael,(PetscMPIInt)(3*nloc[1]),
+                        MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    UMCOUNTS(0,1)
+    ierr = MPI_Scatterv(newbf,cnt,disp,MPIU_INT,abfl,(PetscMPIInt)nloc[0],
+                        MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = MPI_Scatterv(perm,cnt,disp,MPIU_INT,aperml,(PetscMPIInt)nloc[0],
+                        MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        UMCOUNTS(2,2)
+        ierr = MPI_Scatterv(newns,cnt,disp,MPIU_INT,ansl,(PetscMPIInt)(2*nloc[2]),
+                            MPIU_INT,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    }
+#undef UMCOUNTS
+    ierr = UMCreateFromChunks(mesh,alocl,ael,abfl,
+                              (mesh->P > 0) ? ansl : NULL); CHKERRQ(ierr);
+    ierr = PetscFree4(alocl,ael,abfl,ansl); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_WORLD,mesh->Nown,aperml,
+                           PETSC_OWN_POINTER,&(mesh->perm)); CHKERRQ(ierr);
+    if (rank == 0) {
+        ierr = PetscFree3(allnloc,cnt,disp); CHKERRQ(ierr);
+        ierr = PetscFree4(newxy,newe,newbf,newns); CHKERRQ(ierr);
+        ierr = PetscFree(perm); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+
+/* Open-addressing hash table of undirected edges (a,b), used by
+UMSetUpEdges() to number the edges of the mesh.  Capacity is a power of two
+at least twice the maximum number of edges, so probing always terminates. */
+typedef struct {
+    PetscInt cap,
+             *a, *b,    // end nodes with a < b; a = -1 for an empty slot
+             *id,       // edge number
+             *count;    // number of elements which have this edge
+} EdgeTable;
+
+static PetscErrorCode EdgeTableCreate(PetscInt maxedges, EdgeTable *t) {
+    PetscErrorCode ierr;
+    PetscInt j;
+    t->cap = 1;
+    while (t->cap < 2 * maxedges)
+        t->cap *= 2;
+    ierr = PetscMalloc4(t->cap,&(t->a),t->cap,&(t->b),
+                        t->cap,&(t->id),t->cap,&(t->count)); CHKERRQ(ierr);
+    for (j = 0; j < t->cap; j++) {
+        t->a[j] = -1;
+        t->count[j] = 0;
+    }
+    return 0;
+}
+
+static PetscErrorCode EdgeTableDestroy(EdgeTable *t) {
+    PetscErrorCode ierr;
+    ierr = PetscFree4(t->a,t->b,t->id,t->count); CHKERRQ(ierr);
+    return 0;
+}
+
+// return the slot holding edge (a,b), or the empty slot where it belongs
+static PetscInt EdgeTableSlot(const EdgeTable *t, PetscInt a, PetscInt b) {
+    PetscInt  tmp, j;
+    if (a > b) {
+        tmp = a;  a = b;  b = tmp;
+    }
+    j = (PetscInt)(((size_t)a * 2654435761u + (size_t)b * 40503u)
+                   & (size_t)(t->cap - 1));
+    while ((t->a[j] >= 0) && ((t->a[j] != a) || (t->b[j] != b)))
+        j = (j + 1) & (t->cap - 1);
+    return j;
+}
+
+// edges are numbered in order of first appearance in the element list
+PetscErrorCode UMSetUpEdges(UM *mesh) {
+    PetscErrorCode ierr;
+    PetscMPIInt    size;
+    const PetscInt *ae, *abf, *ans = NULL, *en;
+    EdgeTable      t;
+    PetscInt       k, l, j, p, a, b;
+
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    if (size > 1) {
+        SETERRQ(PETSC_COMM_SELF,1,"UMSetUpEdges() only implemented on one process\n");
+    }
+    if ((mesh->N == 0) || (!mesh->e) || (!mesh->bf)) {
+        SETERRQ(PETSC_COMM_SELF,2,"mesh not read\n");
+    }
+    if (mesh->ee) {
+        SETERRQ(PETSC_COMM_SELF,3,"edges already set up\n");
+    }
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+
+    ierr = EdgeTableCreate(3*mesh->K,&t); CHKERRQ(ierr);
+    mesh->NE = 0;
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++) {
+            j = EdgeTableSlot(&t,en[l],en[(l+1)%3]);
+            if (t.a[j] < 0) {
+                t.a[j] = PetscMin(en[l],en[(l+1)%3]);
+                t.b[j] = PetscMax(en[l],en[(l+1)%3]);
+                t.id[j] = mesh->NE++;
+            }
+            t.count[j]++;
+        }
+    }
+    ierr = PetscMalloc4(2*mesh->NE,&(mesh->edges),3*mesh->K,&(mesh->ee),
+                        mesh->NE,&(mesh->ebf),mesh->P,&(mesh->nse)); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++)
+            mesh->ee[3*k+l] = t.id[EdgeTableSlot(&t,en[l],en[(l+1)%3])];
+    }
+
+    // an edge is interior if it is shared by two elements; on a boundary
+    //   edge the smaller flag of the ends applies, so an edge is Dirichlet
+    //   only if both ends are
+    for (j = 0; j < t.cap; j++) {
+        if (t.a[j] < 0)
+            continue;
+        a = t.a[j];  b = t.b[j];
+        mesh->edges[2*t.id[j]+0] = a;
+        mesh->edges[2*t.id[j]+1] = b;
+        mesh->ebf[t.id[j]] = (t.count[j] > 1) ? 0
+                                              : PetscMax(1,PetscMin(abf[a],abf[b]));
+    }
+
+    // edges of Neumann segments are Neumann
+    for (p = 0; p < mesh->P; p++) {
+        a = ans[2*p+0];  b = ans[2*p+1];
+        j = EdgeTableSlot(&t,a,b);
+        if (t.a[j] < 0) {
+            SETERRQ2(PETSC_COMM_SELF,4,
+                     "Neumann segment (%d,%d) is not an element edge\n",a,b);
+        }
+        mesh->nse[p] = t.id[j];
+        mesh->ebf[t.id[j]] = 1;
+    }
+
+    if (mesh->P > 0) {
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = EdgeTableDestroy(&t); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMRefine(UM *coarse, UM *fine) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *abf, *ans = NULL, *en;
+    const Node     *aloc;
+    PetscInt       k, l, j, p, a, b, mid, nstart, kstart, pstart,
+                   m[3], *fe, *fbf, *fns = NULL;
+    PetscReal      *fxy;
+
+    if ((fine->N > 0) || (fine->loc) || (fine->e)) {
+        SETERRQ(PETSC_COMM_SELF,3,"fine mesh already created?\n");
+    }
+    // midpoint of edge j is fine node N+j
+    if (!coarse->ee) {
+        ierr = UMSetUpEdges(coarse); CHKERRQ(ierr);
+    }
+    ierr = UMGetNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    if (coarse->P > 0) {
+        ierr = ISGetIndices(coarse->ns,&ans); CHKERRQ(ierr);
+    }
+    fine->N = coarse->N + coarse->NE;
+    fine->K = 4 * coarse->K;
+    fine->P = 2 * coarse->P;
+    ierr = PetscMalloc3(2*fine->N,&fxy,3*fine->K,&fe,fine->N,&fbf); CHKERRQ(ierr);
+
+    // nodes and boundary flags; a midpoint has the flag of its edge
+    for (j = 0; j < coarse->N; j++) {
+        fxy[2*j+0] = aloc[j].x;
+        fxy[2*j+1] = aloc[j].y;
+        fbf[j] = abf[j];
+    }
+    for (j = 0; j < coarse->NE; j++) {
+        a = coarse->edges[2*j+0];  b = coarse->edges[2*j+1];
+        mid = coarse->N + j;
+        fxy[2*mid+0] = 0.5 * (aloc[a].x + aloc[b].x);
+        fxy[2*mid+1] = 0.5 * (aloc[a].y + aloc[b].y);
+        fbf[mid] = coarse->ebf[j];
+    }
+
+    // each Neumann segment becomes two
+    if (coarse->P > 0) {
+        ierr = PetscMalloc1(2*fine->P,&fns); CHKERRQ(ierr);
+        for (p = 0; p < coarse->P; p++) {
+            a = ans[2*p+0];  b = ans[2*p+1];
+            mid = coarse->N + coarse->nse[p];
+            fns[4*p+0] = a;     fns[4*p+1] = mid;
+            fns[4*p+2] = mid;   fns[4*p+3] = b;
+        }
+    }
+
+    // four children of each element, with the orientation of the parent
+    for (k = 0; k < coarse->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++)
+            m[l] = coarse->N + coarse->ee[3*k+l];
+        // m[0] on edge en[0]en[1], m[1] on en[1]en[2], m[2] on en[2]en[0]
+        fe[12*k+0] = en[0];  fe[12*k+1]  = m[0];   fe[12*k+2]  = m[2];
+        fe[12*k+3] = m[0];   fe[12*k+4]  = en[1];  fe[12*k+5]  = m[1];
+        fe[12*k+6] = m[2];   fe[12*k+7]  = m[1];   fe[12*k+8]  = en[2];
+        fe[12*k+9] = m[0];   fe[12*k+10] = m[1];   fe[12*k+11] = m[2];
+    }
+
+    if (coarse->P > 0) {
+        ierr = ISRestoreIndices(coarse->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+
+    ierr = UMSplitOwnership(fine,&nstart,&kstart,&pstart); CHKERRQ(ierr);
+    ierr = UMCreateFromChunks(fine,fxy,fe,fbf,fns); CHKERRQ(ierr);
+    ierr = PetscFree3(fxy,fe,fbf); CHKERRQ(ierr);
+    ierr = PetscFree(fns); CHKERRQ(ierr);
+    return 0;
+}
+
+/* The P1 interpolation from coarse to fine is exact for nested meshes:  a
+fine node which is a coarse node copies its value and an edge midpoint
+averages the two ends.  Entries which would couple a Dirichlet node to a
+non-Dirichlet node are dropped, so that Galerkin coarse operators keep the
+decoupled Dirichlet rows of the fine operator. */
+PetscErrorCode UMCreateProlongation(UM *coarse, UM *fine, Mat *P) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *afe, *abfc, *abff, *en;
+    PetscInt       k, l, n, mid, end[2], cols[2], nc;
+    PetscReal      one = 1.0, vals[2];
+
+    if ((fine->N <= coarse->N) || (fine->K != 4 * coarse->K)) {
+        SETERRQ(PETSC_COMM_SELF,1,"fine mesh not from UMRefine(coarse,fine)\n");
+    }
+    if (fine->perm || coarse->perm) {
+        SETERRQ(PETSC_COMM_SELF,2,"reordered meshes not allowed\n");
+    }
+    ierr = MatCreate(PETSC_COMM_WORLD,P); CHKERRQ(ierr);
+    ierr = MatSetSizes(*P,fine->Nown,coarse->Nown,fine->N,coarse->N); CHKERRQ(ierr);
+    ierr = MatSetType(*P,MATAIJ); CHKERRQ(ierr);
+    ierr = MatSeqAIJSetPreallocation(*P,2,NULL); CHKERRQ(ierr);
+    ierr = MatMPIAIJSetPreallocation(*P,2,NULL,2,NULL); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(fine->e,&afe); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->bf,&abfc); CHKERRQ(ierr);
+    ierr = ISGetIndices(fine->bf,&abff); CHKERRQ(ierr);
+    for (n = 0; n < coarse->N; n++) {
+        ierr = MatSetValues(*P,1,&n,1,&n,&one,INSERT_VALUES); CHKERRQ(ierr);
+    }
+    for (k = 0; k < coarse->K; k++) {
+        en = ae + 3*k;
+        // midpoints in children 4k, 4k+1 from UMRefine():  child 4k is
+        //   (en[0],m[0],m[2]) and child 4k+1 is (m[0],en[1],m[1])
+        for (l = 0; l < 3; l++) {
+            mid = (l == 0) ? afe[12*k+1] : ((l == 1) ? afe[12*k+5] : afe[12*k+2]);
+            end[0] = en[l];
+            end[1] = en[(l+1)%3];
+            nc = 0;
+            for (n = 0; n < 2; n++) {
+                if ((abfc[end[n]] == 2) == (abff[mid] == 2)) {
+                    cols[nc] = end[n];
+                    vals[nc++] = 0.5;
+                }
+            }
+            ierr = MatSetValues(*P,1,&mid,nc,cols,vals,INSERT_VALUES); CHKERRQ(ierr);
+        }
+    }
+    ierr = ISRestoreIndices(fine->bf,&abff); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(coarse->bf,&abfc); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(fine->e,&afe); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = MatAssemblyBegin(*P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(*P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    return 0;
+}
+
+/* Newest-vertex bisection.  First the refinement edges of marked elements
+are marked, then any element with a marked edge gets its refinement edge
+marked, until nothing changes.  Then each element whose refinement edge is
+marked is split into two children, at that edge, whose newest vertex is the
+midpoint.  The refinement edges of the children are the other two edges of
+the parent, so a child is split again if its refinement edge is marked. */
+PetscErrorCode UMBisect(UM *coarse, const PetscBool *marked, PetscBool longest,
+                        UM *fine, PetscInt **parents) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *abf, *ans = NULL, *en;
+    const Node     *aloc;
+    PetscBool      *emark, changed;
+    PetscInt       k, l, j, p, a, b, nnew, nstart, kstart, pstart,
+                   *base, *mid, *fe, *fbf, *fns = NULL, kf, pf,
+                   pk, b1, b2, jb, j1, j2, m, mm;
+    PetscReal      *fxy, len, maxlen;
+
+    if ((fine->N > 0) || (fine->loc) || (fine->e)) {
+        SETERRQ(PETSC_COMM_SELF,3,"fine mesh already created?\n");
+    }
+    if (!coarse->ee) {
+        ierr = UMSetUpEdges(coarse); CHKERRQ(ierr);
+    }
+    ierr = UMGetNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    if (coarse->P > 0) {
+        ierr = ISGetIndices(coarse->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = PetscMalloc3(coarse->K,&base,coarse->NE,&emark,coarse->NE,&mid); CHKERRQ(ierr);
+
+    // refinement edge of element k is en[base[k]]en[(base[k]+1)%3]
+    for (k = 0; k < coarse->K; k++) {
+        en = ae + 3*k;
+        base[k] = 1;
+        if (longest) {
+            maxlen = -1.0;
+            for (l = 0; l < 3; l++) {
+                a = en[l];  b = en[(l+1)%3];
+                len = PetscSqr(aloc[b].x - aloc[a].x) + PetscSqr(aloc[b].y - aloc[a].y);
+                if (len > maxlen) {
+                    maxlen = len;
+                    base[k] = l;
+                }
+            }
+        }
+    }
+
+    // mark edges, with closure for conformity
+    for (j = 0; j < coarse->NE; j++)
+        emark[j] = PETSC_FALSE;
+    for (k = 0; k < coarse->K; k++) {
+        if (marked[k])
+            emark[coarse->ee[3*k+base[k]]] = PETSC_TRUE;
+    }
+    do {
+        changed = PETSC_FALSE;
+        for (k = 0; k < coarse->K; k++) {
+            jb = coarse->ee[3*k+base[k]];
+            if (emark[jb])
+                continue;
+            for (l = 0; l < 3; l++) {
+                if (emark[coarse->ee[3*k+l]]) {
+                    emark[jb] = PETSC_TRUE;
+                    changed = PETSC_TRUE;
+                    break;
+                }
+            }
+        }
+    } while (changed);
+
+    // new nodes at midpoints of marked edges; count fine elements, segments
+    nnew = 0;
+    for (j = 0; j < coarse->NE; j++)
+        mid[j] = (emark[j]) ? coarse->N + nnew++ : -1;
+    fine->N = coarse->N + nnew;
+    fine->K = 0;
+    for (k = 0; k < coarse->K; k++) {
+        fine->K += 1;
+        if (emark[coarse->ee[3*k+base[k]]]) {
+            fine->K += 1;
+            for (l = 1; l < 3; l++)
+                if (emark[coarse->ee[3*k+(base[k]+l)%3]])
+                    fine->K += 1;
+        }
+    }
+    fine->P = coarse->P;
+    for (p = 0; p < coarse->P; p++)
+        if (emark[coarse->nse[p]])
+            fine->P += 1;
+    ierr = PetscMalloc3(2*fine->N,&fxy,3*fine->K,&fe,fine->N,&fbf); CHKERRQ(ierr);
+    if (parents) {
+        ierr = PetscMalloc1(2*nnew,parents); CHKERRQ(ierr);
+    }
+
+    // nodes and boundary flags; a midpoint has the flag of its edge
+    for (j = 0; j < coarse->N; j++) {
+        fxy[2*j+0] = aloc[j].x;
+        fxy[2*j+1] = aloc[j].y;
+        fbf[j] = abf[j];
+    }
+    for (j = 0; j < coarse->NE; j++) {
+        if (mid[j] < 0)
+            continue;
+        a = coarse->edges[2*j+0];  b = coarse->edges[2*j+1];
+        fxy[2*mid[j]+0] = 0.5 * (aloc[a].x + aloc[b].x);
+        fxy[2*mid[j]+1] = 0.5 * (aloc[a].y + aloc[b].y);
+        fbf[mid[j]] = coarse->ebf[j];
+        if (parents) {
+            (*parents)[2*(mid[j]-coarse->N)+0] = a;
+            (*parents)[2*(mid[j]-coarse->N)+1] = b;
+        }
+    }
+
+    // children are written with the newest vertex first
+#define PUTELEMENT(A,B,C) { fe[3*kf+0] = (A);  fe[3*kf+1] = (B);  fe[3*kf+2] = (C);  kf++; }
+    kf = 0;
+    for (k = 0; k < coarse->K; k++) {
+        en = ae + 3*k;
+        l = base[k];
+        b1 = en[l];  b2 = en[(l+1)%3];  pk = en[(l+2)%3];
+        jb = coarse->ee[3*k+l];          // b1 b2
+        j1 = coarse->ee[3*k+(l+1)%3];    // b2 pk
+        j2 = coarse->ee[3*k+(l+2)%3];    // pk b1
+        if (!emark[jb]) {
+            PUTELEMENT(pk,b1,b2);
+            continue;
+        }
+        m = mid[jb];
+        if (emark[j2]) {  // child (m; pk,b1) split at pk b1
+            mm = mid[j2];
+            PUTELEMENT(mm,m,pk);
+            PUTELEMENT(mm,b1,m);
+        } else {
+            PUTELEMENT(m,pk,b1);
+        }
+        if (emark[j1]) {  // child (m; b2,pk) split at b2 pk
+            mm = mid[j1];
+            PUTELEMENT(mm,m,b2);
+            PUTELEMENT(mm,pk,m);
+        } else {
+            PUTELEMENT(m,b2,pk);
+        }
+    }
+#undef PUTELEMENT
+
+    // a Neumann segment on a marked edge becomes two
+    if (fine->P > 0) {
+        ierr = PetscMalloc1(2*fine->P,&fns); CHKERRQ(ierr);
+        pf = 0;
+        for (p = 0; p < coarse->P; p++) {
+            a = ans[2*p+0];  b = ans[2*p+1];
+            j = coarse->nse[p];
+            if (emark[j]) {
+                fns[2*pf+0] = a;       fns[2*pf+1] = mid[j];  pf++;
+                fns[2*pf+0] = mid[j];  fns[2*pf+1] = b;       pf++;
+            } else {
+                fns[2*pf+0] = a;       fns[2*pf+1] = b;       pf++;
+            }
+        }
+    }
+
+    if (coarse->P > 0) {
+        ierr = ISRestoreIndices(coarse->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+    ierr = PetscFree3(base,emark,mid); CHKERRQ(ierr);
+
+    ierr = UMSplitOwnership(fine,&nstart,&kstart,&pstart); CHKERRQ(ierr);
+    ierr = UMCreateFromChunks(fine,fxy,fe,fbf,fns); CHKERRQ(ierr);
+    ierr = PetscFree3(fxy,fe,fbf); CHKERRQ(ierr);
+    ierr = PetscFree(fns); CHKERRQ(ierr);
+    return 0;
+}
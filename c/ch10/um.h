@@ -7,24 +7,79 @@ typedef struct {
     PetscReal  x,y;
 } Node;
 
+// optional per-element geometry, computed once; structure-of-arrays
+//   layout with each array indexed by element k = 0,...,Kown-1
+typedef struct {
+    PetscReal *x0, *y0,       // location of node en[0] of element
+              *dx1, *dx2,     // dx1 = x[en[1]] - x[en[0]], etc.
+              *dy1, *dy2,
+              *detJ,          // determinant of reference-to-element map
+              *gx[3], *gy[3], // hat function gradients: gx[l][k], gy[l][k]
+              *gD;            // Dirichlet boundary values at local nodes;
+                              //     length Nown+Ngh; may be a null ptr
+} UMGeometryCache;
+
+// node renumberings for locality; see UMReorder()
+typedef enum {REORDER_NONE, REORDER_RCM, REORDER_HILBERT} UMReorderType;
+
 // data type for an Unstructured Mesh
 typedef struct {
     PetscInt N,     // number of nodes
              K,     // number of elements
              P;     // number of Neumann boundary segments; may be 0
-    Vec      loc;   // nodal locations; length N, dof=2 Vec
-    IS       e,     // element triples; length 3K
+    Vec      loc;   // nodal locations; length N, dof=2 ghosted Vec
+    IS       e,     // element triples; length 3Kown
                     //     values e[3*k+0],e[3*k+1],e[3*k+2]
-                    //     are indices into node-based Vecs
-             bf,    // flag for boundary nodes; length N
+                    //     are local indices into node-based Vecs
+             bf,    // flag for boundary nodes; length Nown+Ngh
                     //     if bf[i] > 0  then node i is on boundary
                     //     if bf[i] == 2 then node i is Dirichlet
-             ns;    // Neumann boundary segment pairs; length 2P;
+             ns;    // Neumann boundary segment pairs; length 2Pown;
                     //     may be a null ptr; values s[2*p+0],s[2*p+1]
-                    //     are indices into node-based Vecs
+                    //     are local indices into node-based Vecs
+    // parallel layout; on one process Nown=N, Ngh=0, Kown=K, Pown=P
+    PetscInt Nown,  // number of nodes owned by this process
+             Ngh,   // number of ghost nodes on this process
+             Kown,  // number of elements owned by this process
+             Pown;  // number of Neumann segments owned by this process
+    ISLocalToGlobalMapping ltog;  // local node numbering to global; local
+                    //     nodes 0,...,Nown-1 are owned, then Ngh ghosts
+    UMGeometryCache *geom;  // may be a null ptr; see UMSetUpGeometryCache()
+    IS       perm;  // if reordered then perm[i] is the original (file)
+                    //     index of owned node i; otherwise a null ptr
+    PetscInt ncolors,     // element coloring from UMColorElements(); no
+             *colorptr,   //     two elements of one color share a node;
+             *colorelts;  //     elements of color c are colorelts[j] for
+                          //     colorptr[c] <= j < colorptr[c+1]; null ptrs
+                          //     if not colored
+    PetscInt NE,    // number of edges; from UMSetUpEdges(), otherwise 0
+             *edges,//     and null ptrs:  edge j has end nodes
+                    //     edges[2*j+0] < edges[2*j+1]
+             *ee,   // element edges; ee[3*k+l] is the edge of element k
+                    //     from e[3*k+l] to e[3*k+(l+1)%3]
+             *ebf,  // flag for edges, as for nodes:  0 if interior, 2 if
+                    //     Dirichlet (both ends Dirichlet and not Neumann)
+             *nse;  // nse[p] is the edge of Neumann segment p
+    PetscInt *eltptr,     // adjacency from UMBuildAdjacency(), otherwise null
+             *elts,       //     ptrs; for local node n, the owned elements
+             *nbrptr,     //     containing n are elts[j] for eltptr[n] <=
+             *nbrs;       //     j < eltptr[n+1], and the other local nodes of
+                          //     those elements are nbrs[j] for nbrptr[n] <= j
+                          //     < nbrptr[n+1], in increasing order
+    void     *map;  // if read by UMReadMapped() on one process then loc, e,
+    size_t   maplen;//     bf, ns use this memory mapping; otherwise null
 } UM;
 //ENDSTRUCT
 
+/* On P processes the nodes are distributed in contiguous blocks of the file
+numbering, or, after UMReorder(), of the new numbering.  Each process owns the
+elements and Neumann segments which come from its block of the element and
+segment lists.  Nodes referenced by owned elements or segments, but owned by
+another process, are ghosts.  After UMReadISs() the index sets e, bf, ns are
+sequential and contain *local* node indices, the ghosted Vec loc has valid
+ghost values, and ltog maps local to global node indices.  On one process
+local and global numbering are the same.  */
+
 // methods below are listed in typical call order
 
 //STARTDECLARE
@@ -38,18 +93,105 @@ PetscErrorCode UMReadNodes(UM *mesh, char *filename);
 //   and boundary flags into them; call UMReadNodes() first
 PetscErrorCode UMReadISs(UM *mesh, char *filename);
 
-// view all fields in UM to the viewer
+// alternative to UMReadNodes() and UMReadISs():  memory-map a single .umb
+//   file (see petsc2umb.py) holding a header then node coordinates, element
+//   triples, boundary flags and Neumann segments at 64-byte aligned offsets;
+//   on one process loc, e, bf, ns point into the mapping without copying
+PetscErrorCode UMReadMapped(UM *mesh, char *filename);
+
+// alternative to UMReadNodes() and UMReadISs():  read a Gmsh MSH 4.1 file
+//   (ASCII or binary) directly; boundary flags and Neumann segments come from
+//   physical groups named "dirichlet" and "neumann", as in msh2petsc.py
+PetscErrorCode UMReadGmsh(UM *mesh, char *filename);
+
+// alternative to reading a mesh:  generate the structured mesh of the
+//   rectangle [0,Lx]x[0,Ly] with M x N nodes, each rectangular cell cut into
+//   two triangles as by genstructured.py; sides are Dirichlet unless
+//   flagged in neumann[4] (south, east, north, west), which may be a null
+//   ptr; each process generates only the chunks it owns
+PetscErrorCode UMCreateStructured(UM *mesh, PetscInt M, PetscInt N,
+                                  PetscReal Lx, PetscReal Ly,
+                                  const PetscBool *neumann);
+
+// number the edges of the mesh and set NE, edges, ee, ebf, nse; one process
+//   only; call after UMReorder()
+PetscErrorCode UMSetUpEdges(UM *mesh);
+
+// create fine mesh by splitting each triangle of coarse mesh into four, at
+//   edge midpoints; midpoint of edge j is fine node N+j; boundary flags and
+//   Neumann segments are inherited; fine must be initialized but empty;
+//   one process only; call after UMReadISs() and before UMReorder()
+PetscErrorCode UMRefine(UM *coarse, UM *fine);
+
+// create the P1 interpolation matrix from coarse to fine, where fine was
+//   created by UMRefine(coarse,fine); suitable for PCMGSetInterpolation()
+PetscErrorCode UMCreateProlongation(UM *coarse, UM *fine, Mat *P);
+
+// create fine mesh by newest-vertex bisection of the marked elements of
+//   coarse, plus the bisections needed for conformity; the newest vertex of
+//   element k is e[3*k+0] and its refinement edge is e[3*k+1]e[3*k+2], or,
+//   if longest is true, the refinement edge is the longest edge (use on the
+//   initial mesh); new nodes are midpoints of coarse edges and number from
+//   coarse->N; if parents is not null then it is allocated and (*parents)[2*i],
+//   (*parents)[2*i+1] are the ends of the edge bisected by new node coarse->N+i;
+//   one process only
+PetscErrorCode UMBisect(UM *coarse, const PetscBool *marked, PetscBool longest,
+                        UM *fine, PetscInt **parents);
+
+// renumber nodes by reverse Cuthill-McKee or by position along a Hilbert
+//   curve, then sort elements by their minimum node; permutes loc, e, bf, ns;
+//   on P processes the ordering is computed on rank 0 and then each process
+//   owns a contiguous block of the new numbering; call after UMReadISs()
+PetscErrorCode UMReorder(UM *mesh, UMReorderType type);
+
+// view all fields in UM to the viewer; the solution is written in the
+//   original (file) node numbering even if the mesh was reordered
 PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer);
 PetscErrorCode UMViewSolutionBinary(UM *mesh, char *filename, Vec u);
 
+// write mesh and nodal values to a VTK XML unstructured grid (.vtu) file with
+//   raw binary appended data, in the current node numbering; the values are
+//   the first Nown local entries of u; other processes send their parts to
+//   rank 0 in bounded chunks, so there is no gathered copy of the mesh
+PetscErrorCode UMViewVTU(UM *mesh, char *filename, Vec u);
+
 // compute statistics for mesh:  maxh,meanh are for triangle side
 //   lengths; maxa,meana are for areas
 PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
                        PetscReal *maxa, PetscReal *meana);
 
-// access to a length-N array of structs for nodal coordinates
+// access to a length-(Nown+Ngh) array of structs for nodal coordinates
 PetscErrorCode UMGetNodeCoordArrayRead(UM *mesh, const Node **xy);
 PetscErrorCode UMRestoreNodeCoordArrayRead(UM *mesh, const Node **xy);
 //ENDDECLARE
+
+// compute and store per-element geometry so that assembly need not recompute
+//   it; if gD_fcn is given then also store Dirichlet values at nodes with
+//   bf == 2; call after UMReadISs()
+PetscErrorCode UMSetUpGeometryCache(UM *mesh,
+                                    PetscReal (*gD_fcn)(PetscReal, PetscReal));
+
+// greedy coloring of the owned elements so that elements of one color share
+//   no node; loops over one color can then scatter-add to nodes from
+//   several threads without atomics; call after UMReorder()
+PetscErrorCode UMColorElements(UM *mesh);
+
+// build node-to-element and node-to-node adjacency, in CSR form, for local
+//   nodes and owned elements, in O(Nown+Ngh+Kown) time; call after
+//   UMReorder(), which refuses a mesh with adjacency
+PetscErrorCode UMBuildAdjacency(UM *mesh);
+
+// create a ghosted Vec with one entry per node; global length N
+PetscErrorCode UMCreateGlobalVec(UM *mesh, Vec *v);
+
+// get local (owned then ghost) form of a Vec from UMCreateGlobalVec(); on
+//   one process any length-N Vec is allowed
+PetscErrorCode UMVecGetLocalForm(UM *mesh, Vec v, Vec *vl);
+PetscErrorCode UMVecRestoreLocalForm(UM *mesh, Vec v, Vec *vl);
+
+// update ghost values:  use INSERT_VALUES,SCATTER_FORWARD to get ghost
+//   values from owners, ADD_VALUES,SCATTER_REVERSE to sum into owners
+PetscErrorCode UMVecGhostUpdate(UM *mesh, Vec v, InsertMode imode,
+                                ScatterMode smode);
 #endif
 
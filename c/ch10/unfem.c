@@ -20,9 +20,28 @@ typedef struct {
               quaddegree;
     PetscReal (*a_fcn)(PetscReal, PetscReal, PetscReal);
     PetscReal (*f_fcn)(PetscReal, PetscReal, PetscReal);
+    PetscReal (*da_fcn)(PetscReal, PetscReal, PetscReal);  // = da/du
+    PetscReal (*df_fcn)(PetscReal, PetscReal, PetscReal);  // = df/du
+    // optional batched forms of a_fcn, f_fcn:  out[i] = a(u[i],x[i],y[i])
+    void      (*a_batch)(PetscInt, const PetscReal*, const PetscReal*,
+                         const PetscReal*, PetscReal*);
+    void      (*f_batch)(PetscInt, const PetscReal*, const PetscReal*,
+                         const PetscReal*, PetscReal*);
     PetscReal (*gD_fcn)(PetscReal, PetscReal);
     PetscReal (*gN_fcn)(PetscReal, PetscReal);
     PetscReal (*uexact_fcn)(PetscReal, PetscReal);
+    PetscInt  *eoff;  // if not null, offsets of element matrix entries in
+                      //   the SeqAIJ value array; see PreallocateCSR()
+    PetscReal psi[3][MAXPTS_TRI];  // hat functions tabulated at quadrature
+                      //   points: psi[L][r] = chi(L,xi[r],eta[r])
+    // for -un_order 2; see SetUpP2()
+    PetscInt  order,
+              N2,     // number of P2 nodes:  mesh nodes then edge midpoints
+              *e2,    // e2[6*k+0,...,5] are the P2 nodes of element k
+              *bf2;   // boundary flags at P2 nodes
+    Node      *loc2;  // locations of P2 nodes
+    PetscReal psi2[6][MAXPTS_TRI],      // P2 basis at quadrature points
+              dpsi2[6][MAXPTS_TRI][2];  //   and its gradient on ref. element
     PetscLogStage readstage, setupstage, solverstage, resstage, jacstage;  //STRIP
 } unfemCtx;
 //ENDCTX
@@ -43,40 +62,103 @@ PetscReal eval(const PetscReal v[3], PetscReal xi, PetscReal eta) {
         sum += v[L] * chi(L,xi,eta);
     return sum;
 }
+
+// fill user->psi for the rule of degree user->quaddegree
+static void TabulateHat(unfemCtx *user) {
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    PetscInt         L, r;
+    for (L = 0; L < 3; L++)
+        for (r = 0; r < q.n; r++)
+            user->psi[L][r] = chi(L,q.xi[r],q.eta[r]);
+}
+
+// same as eval() but at quadrature point r, using tabulated hat functions
+static PetscReal evalq(const unfemCtx *user, const PetscReal v[3], PetscInt r) {
+    PetscReal  sum = 0.0;
+    PetscInt   L;
+    for (L = 0; L < 3; L++)
+        sum += v[L] * user->psi[L][r];
+    return sum;
+}
 //ENDFEM
 
+static const char* UMReorderTypes[] = {"none","rcm","hilbert",
+                                       "UMReorderType", "", NULL};
+
+typedef enum {PICARD, NEWTON} JacobianType;
+static const char* JacobianTypes[] = {"picard","newton",
+                                      "JacobianType", "", NULL};
+
 extern PetscErrorCode FillExact(Vec, unfemCtx*);
 extern PetscErrorCode FormFunction(SNES, Vec, Vec, void*);
 extern PetscErrorCode FormPicard(SNES, Vec, Mat, Mat, void*);
+extern PetscErrorCode FormJacobian(SNES, Vec, Mat, Mat, void*);
 extern PetscErrorCode PreallocateAndSetNonzeros(Mat, unfemCtx*);
+extern PetscErrorCode PreallocateCSR(Mat, unfemCtx*);
+extern PetscErrorCode LoadHierarchy(PC, UM*, UMReorderType, const char*, Vec);
+extern PetscErrorCode SaveHierarchy(PC, UM*, UMReorderType, const char*);
+extern PetscErrorCode AdaptSolve(unfemCtx*, JacobianType, Vec);
+extern PetscErrorCode ErrorIndicators(unfemCtx*, Vec, PetscReal*, PetscReal*);
+extern PetscErrorCode DorflerMark(PetscInt, const PetscReal*, PetscReal,
+                                  PetscBool*, PetscInt*);
+extern PetscErrorCode InterpolateBisected(UM*, UM*, const PetscInt*, Vec*);
+extern PetscErrorCode SetUpP2(unfemCtx*);
+extern PetscErrorCode FormFunctionP2(SNES, Vec, Vec, void*);
+extern PetscErrorCode PreallocateP2(Mat, unfemCtx*);
+static void TabulateP2(unfemCtx*);
+static PetscErrorCode AssembleMatrixP2(Vec, Mat, unfemCtx*, PetscBool);
+
+// context for the matrix-free (-un_matfree) Picard operator
+typedef struct {
+    unfemCtx  *user;
+    PetscReal *coef;     // per-element coefficient |det J| sum_r w_r a(u_r)
+    Vec       xg, yg,    // ghosted work Vecs for MatMult
+              diag;      // assembled diagonal
+} matfreeCtx;
+
+extern PetscErrorCode MatFreeCreate(unfemCtx*, matfreeCtx*, Mat*);
+extern PetscErrorCode MatFreeDestroy(matfreeCtx*);
+extern PetscErrorCode FormMatFree(SNES, Vec, Mat, Mat, void*);
 
 int main(int argc,char **argv) {
     PetscErrorCode ierr;
     PetscMPIInt size;
+    int         smx, smy;
     PetscBool   viewmesh = PETSC_FALSE,
                 viewsoln = PETSC_FALSE,
                 noprealloc = PETSC_FALSE,
+                geomcache = PETSC_FALSE,
+                csr = PETSC_TRUE,
+                color = PETSC_FALSE,
+                matfree = PETSC_FALSE,
+                isseqaij,
                 savepintbinary = PETSC_FALSE,
-                savepintmatlab = PETSC_FALSE;
+                savepintmatlab = PETSC_FALSE,
+                mapped = PETSC_FALSE,
+                gmsh = PETSC_FALSE,
+                structured = PETSC_FALSE,
+                quadset;
     char        root[256] = "", nodesname[256], issname[256], solnname[256],
-                pintname[256] = "";
-    PetscInt    savepintlevel = -1, levels;
+                pintname[256] = "", loadhier[256] = "", savehier[256] = "",
+                vtuname[256] = "", *ext;
+    PetscInt    savepintlevel = -1, levels, refine = 0, gmglevels = 0, j,
+                adapt = 0;
+    UMReorderType reorder = REORDER_NONE;
+    JacobianType  jactype = PICARD;
     UM          mesh;
     unfemCtx    user;
+    matfreeCtx  mf;
     SNES        snes;
     KSP         ksp;
     PC          pc;
     PCType      pctype;
-    Mat         A;
-    Vec         r, u, uexact;
-    PetscReal   err, h_max;
+    Mat         A, *gmgP = NULL;
+    Vec         r, u, uexact, uadapt = NULL;
+    PetscReal   err, h_max, theta = 0.5;
 
     ierr = PetscInitialize(&argc,&argv,NULL,help); if (ierr) return ierr;
 
     ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
-    if (size != 1) {
-        SETERRQ(PETSC_COMM_SELF,1,"unfem only works on one MPI process");
-    }
 
     ierr = PetscLogStageRegister("Read mesh      ", &user.readstage); CHKERRQ(ierr);  //STRIP
     ierr = PetscLogStageRegister("Set-up         ", &user.setupstage); CHKERRQ(ierr);  //STRIP
@@ -86,10 +168,31 @@ int main(int argc,char **argv) {
 
     user.quaddegree = 1;
     user.solncase = 0;
+    user.eoff = NULL;
+    user.order = 1;
+    user.N2 = 0;
+    user.e2 = NULL;
+    user.bf2 = NULL;
+    user.loc2 = NULL;
     ierr = PetscOptionsBegin(PETSC_COMM_WORLD, "un_", "options for unfem", ""); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-adapt",
+           "number of adaptive cycles (solve, estimate, mark, bisect) before the final solve",
+           "unfem.c",adapt,&adapt,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsReal("-adapt_theta",
+           "Dorfler marking parameter in (0,1]: mark elements holding this fraction of the squared estimate",
+           "unfem.c",theta,&theta,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsInt("-case",
            "exact solution cases: 0=linear, 1=nonlinear, 2=nonhomoNeumann, 3=chapter3, 4=koch",
            "unfem.c",user.solncase,&(user.solncase),NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-gmg_levels",
+           "if L > 1 then refine mesh L-1 times and use geometric multigrid (PCMG) with P1 interpolation",
+           "unfem.c",gmglevels,&gmglevels,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsString("-gamg_load_hierarchy",
+           "read interpolations for all levels from ROOT.pint (see -un_gamg_save_hierarchy) and use PCMG with Galerkin coarse operators",
+           "unfem.c",loadhier,loadhier,sizeof(loadhier),NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsString("-gamg_save_hierarchy",
+           "save interpolations for all levels of GAMG to ROOT.pint, in PETSc binary format, coarsest first",
+           "unfem.c",savehier,savehier,sizeof(savehier),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsString("-gamg_save_pint_binary",
            "filename under which to save interpolation operator (Mat) in PETSc binary format",
            "unfem.c",pintname,pintname,sizeof(pintname),&savepintbinary); CHKERRQ(ierr);
@@ -99,35 +202,120 @@ int main(int argc,char **argv) {
     ierr = PetscOptionsInt("-gamg_save_pint_level",
            "saved interpolation operator is between L-1 and L where this option sets L; defaults to finest levels",
            "unfem.c",savepintlevel,&savepintlevel,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-color",
+           "color elements so that assembly runs color-by-color; threaded if compiled with OpenMP",
+           "unfem.c",color,&color,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-csr",
+           "on one process, build the CSR sparsity directly and assemble the Picard matrix into its value array",
+           "unfem.c",csr,&csr,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-geometry_cache",
+           "compute element geometry and Dirichlet values once and reuse them in residual and Picard evaluations",
+           "unfem.c",geomcache,&geomcache,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsEnum("-jacobian",
+           "matrix for the nonlinear iteration: Picard (a(u) frozen; symmetric) or Newton (full derivative)",
+           "unfem.c",JacobianTypes,(PetscEnum)jactype,(PetscEnum*)&jactype,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-matfree",
+           "apply Picard operator element-by-element through a MatShell; only its diagonal is assembled",
+           "unfem.c",matfree,&matfree,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsString("-mesh",
-           "file name root of mesh stored in PETSc binary with .vec,.is extensions",
+           "file name root of mesh stored in PETSc binary with .vec,.is extensions, or single-file mesh foo.umb, or Gmsh 4.1 mesh foo.msh, or structured:MxN for an MxN-node mesh of the unit square",
            "unfem.c",root,root,sizeof(root),NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-order",
+           "polynomial degree of Lagrange elements: 1 = P1, 2 = P2 (one process only)",
+           "unfem.c",user.order,&(user.order),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsBool("-noprealloc",
            "do not perform preallocation before matrix assembly",
            "unfem.c",noprealloc,&noprealloc,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsInt("-quaddegree",
-           "quadrature degree (1,2,3)",
-           "unfem.c",user.quaddegree,&(user.quaddegree),NULL); CHKERRQ(ierr);
+           "quadrature degree (1,...,10)",
+           "unfem.c",user.quaddegree,&(user.quaddegree),&quadset); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-refine",
+           "uniformly refine the mesh this many times after reading, splitting each triangle into four",
+           "unfem.c",refine,&refine,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsEnum("-reorder",
+           "renumber nodes and sort elements for memory locality after reading mesh",
+           "unfem.c",UMReorderTypes,(PetscEnum)reorder,(PetscEnum*)&reorder,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsBool("-view_mesh",
            "view loaded mesh (nodes and elements) at stdout",
            "unfem.c",viewmesh,&viewmesh,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsBool("-view_solution",
            "view solution u(x,y) to binary file; uses root name of mesh plus .soln\nsee petsc2tricontour.py to view graphically",
            "unfem.c",viewsoln,&viewsoln,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsString("-view_vtu",
+           "write mesh and solution u(x,y) to this VTK XML (.vtu) file, e.g. for ParaView",
+           "unfem.c",vtuname,vtuname,sizeof(vtuname),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsEnd(); CHKERRQ(ierr);
+    if ((user.order < 1) || (user.order > 2)) {
+        SETERRQ(PETSC_COMM_SELF,10,"-un_order must be 1 or 2");
+    }
+    if (adapt > 0) {
+        if (size > 1 || user.order == 2 || matfree || gmglevels > 1 || reorder != REORDER_NONE) {
+            SETERRQ(PETSC_COMM_SELF,11,
+                    "-un_adapt is for one process, and not with -un_order 2, -un_matfree, -un_gmg_levels, or -un_reorder");
+        }
+        if ((theta <= 0.0) || (theta > 1.0)) {
+            SETERRQ(PETSC_COMM_SELF,11,"-un_adapt_theta must be in (0,1]");
+        }
+    }
+    if (user.order == 2) {
+        if (size > 1 || matfree || gmglevels > 1 || color) {
+            SETERRQ(PETSC_COMM_SELF,10,
+                    "-un_order 2 is for one process, and not with -un_matfree, -un_gmg_levels, or -un_color");
+        }
+        if (!quadset)
+            user.quaddegree = 4;  // exact for P2 mass terms with quadratic f
+    }
+    if ((user.quaddegree < 1) || (user.quaddegree > MAXDEGREE_TRI)) {
+        SETERRQ1(PETSC_COMM_SELF,9,"-un_quaddegree must be in 1,...,%d",MAXDEGREE_TRI);
+    }
+    TabulateHat(&user);
+    if (user.order == 2)
+        TabulateP2(&user);
 
     // determine filenames
     if (strlen(root) == 0) {
         SETERRQ(PETSC_COMM_SELF,2,"no mesh name root given; rerun with '-un_mesh foo'");
     }
-    strcpy(nodesname, root);
-    strncat(nodesname, ".vec", 5);
+    if (matfree && jactype == NEWTON) {
+        SETERRQ(PETSC_COMM_SELF,7,"-un_matfree applies the Picard operator only; use -un_jacobian picard");
+    }
+    if (matfree && gmglevels > 1) {
+        SETERRQ(PETSC_COMM_SELF,7,"-un_gmg_levels needs an assembled matrix; do not use -un_matfree");
+    }
+    if ((strlen(loadhier) > 0) && (matfree || gmglevels > 1)) {
+        SETERRQ(PETSC_COMM_SELF,12,"-un_gamg_load_hierarchy needs an assembled matrix, and not with -un_gmg_levels");
+    }
+    // a name ending in .umb is a single-file mesh (see petsc2umb.py), one
+    //   ending in .msh is read directly from Gmsh output, and structured:MxN
+    //   is generated on the unit square (see genstructured.py)
+    if (strncmp(root,"structured:",11) == 0) {
+        if ((sscanf(root+11,"%dx%d",&smx,&smy) != 2) || (smx < 2) || (smy < 2)) {
+            SETERRQ(PETSC_COMM_SELF,13,"-un_mesh structured:MxN needs integers M,N >= 2");
+        }
+        structured = PETSC_TRUE;
+    }
+    ext = strrchr(root,'.');
+    if (ext && (strcmp(ext,".umb") == 0))
+        mapped = PETSC_TRUE;
+    if (ext && (strcmp(ext,".msh") == 0))
+        gmsh = PETSC_TRUE;
+    if (mapped || gmsh) {
+        strcpy(nodesname, root);
+        *ext = '\0';  // root without extension is used for .soln
+    } else {
+        strcpy(nodesname, root);
+        strncat(nodesname, ".vec", 5);
+    }
     strcpy(issname, root);
     strncat(issname, ".is", 4);
 
     // set source/boundary functions and exact solution
     user.a_fcn = &a_lin;
     user.f_fcn = &f_lin;
+    user.a_batch = &a_lin_batch;
+    user.f_batch = &f_lin_batch;
+    user.da_fcn = &da_lin;
+    user.df_fcn = &df_lin;
     user.uexact_fcn = &uexact_lin;
     user.gD_fcn = &gD_lin;
     user.gN_fcn = &gN_lin;
@@ -136,7 +324,10 @@ int main(int argc,char **argv) {
             break;
         case 1 :
             user.a_fcn = &a_nonlin;
+            user.da_fcn = &da_nonlin;
             user.f_fcn = &f_nonlin;
+            user.a_batch = &a_nonlin_batch;
+            user.f_batch = &f_nonlin_batch;
             break;
         case 2 :
             user.gN_fcn = &gN_linneu;
@@ -144,6 +335,8 @@ int main(int argc,char **argv) {
         case 3 :
             user.a_fcn = &a_square;
             user.f_fcn = &f_square;
+            user.a_batch = &a_square_batch;
+            user.f_batch = &f_square_batch;
             user.uexact_fcn = &uexact_square;
             user.gD_fcn = &gD_square;
             user.gN_fcn = NULL;  // seg fault if ever called
@@ -151,6 +344,8 @@ int main(int argc,char **argv) {
         case 4 :
             user.a_fcn = &a_koch;
             user.f_fcn = &f_koch;
+            user.a_batch = &a_koch_batch;
+            user.f_batch = &f_koch_batch;
             user.uexact_fcn = NULL;  // seg fault if ever called
             user.gD_fcn = &gD_koch;
             user.gN_fcn = NULL;  // seg fault if ever called
@@ -162,10 +357,69 @@ int main(int argc,char **argv) {
     PetscLogStagePush(user.readstage);
     // read mesh object of type UM
     ierr = UMInitialize(&mesh); CHKERRQ(ierr);
-    ierr = UMReadNodes(&mesh,nodesname); CHKERRQ(ierr);
-    ierr = UMReadISs(&mesh,issname); CHKERRQ(ierr);
-    ierr = UMStats(&mesh, &h_max, NULL, NULL, NULL); CHKERRQ(ierr);
+    if (structured) {
+        ierr = UMCreateStructured(&mesh,smx,smy,1.0,1.0,NULL); CHKERRQ(ierr);
+    } else if (mapped) {
+        ierr = UMReadMapped(&mesh,nodesname); CHKERRQ(ierr);
+    } else if (gmsh) {
+        ierr = UMReadGmsh(&mesh,nodesname); CHKERRQ(ierr);
+    } else {
+        ierr = UMReadNodes(&mesh,nodesname); CHKERRQ(ierr);
+        ierr = UMReadISs(&mesh,issname); CHKERRQ(ierr);
+    }
+    for (j = 0; j < refine; j++) {
+        UM  fine;
+        ierr = UMInitialize(&fine); CHKERRQ(ierr);
+        ierr = UMRefine(&mesh,&fine); CHKERRQ(ierr);
+        ierr = UMDestroy(&mesh); CHKERRQ(ierr);
+        mesh = fine;
+    }
+    // nested hierarchy for -un_gmg_levels; only interpolations are kept
+    if (gmglevels > 1) {
+        if (reorder != REORDER_NONE) {
+            SETERRQ(PETSC_COMM_SELF,8,"-un_gmg_levels and -un_reorder cannot be combined");
+        }
+        ierr = PetscMalloc1(gmglevels,&gmgP); CHKERRQ(ierr);
+        gmgP[0] = NULL;
+        for (j = 1; j < gmglevels; j++) {
+            UM  fine;
+            ierr = UMInitialize(&fine); CHKERRQ(ierr);
+            ierr = UMRefine(&mesh,&fine); CHKERRQ(ierr);
+            ierr = UMCreateProlongation(&mesh,&fine,&(gmgP[j])); CHKERRQ(ierr);
+            ierr = UMDestroy(&mesh); CHKERRQ(ierr);
+            mesh = fine;
+        }
+    }
+    ierr = UMReorder(&mesh,reorder); CHKERRQ(ierr);
     user.mesh = &mesh;
+    // adaptive cycles; the last solution, interpolated onto the final mesh,
+    //   is the initial iterate for the solve below
+    for (j = 0; j < adapt; j++) {
+        UM         fine;
+        PetscInt   *parents, nmarked;
+        PetscReal  *eta2, esttotal;
+        PetscBool  *marked;
+        if (j == 0) {
+            ierr = UMCreateGlobalVec(&mesh,&uadapt); CHKERRQ(ierr);
+            ierr = VecSet(uadapt,0.0); CHKERRQ(ierr);
+        }
+        ierr = AdaptSolve(&user,jactype,uadapt); CHKERRQ(ierr);
+        ierr = PetscMalloc2(mesh.K,&eta2,mesh.K,&marked); CHKERRQ(ierr);
+        ierr = ErrorIndicators(&user,uadapt,eta2,&esttotal); CHKERRQ(ierr);
+        ierr = DorflerMark(mesh.K,eta2,theta,marked,&nmarked); CHKERRQ(ierr);
+        ierr = PetscPrintf(PETSC_COMM_WORLD,
+                   "  adaptive cycle %d: N=%d nodes, K=%d elements, estimate %.3e, marked %d\n",
+                   j,mesh.N,mesh.K,PetscSqrtReal(esttotal),nmarked); CHKERRQ(ierr);
+        ierr = UMInitialize(&fine); CHKERRQ(ierr);
+        ierr = UMBisect(&mesh,marked,(j == 0) ? PETSC_TRUE : PETSC_FALSE,
+                        &fine,&parents); CHKERRQ(ierr);
+        ierr = PetscFree2(eta2,marked); CHKERRQ(ierr);
+        ierr = InterpolateBisected(&mesh,&fine,parents,&uadapt); CHKERRQ(ierr);
+        ierr = PetscFree(parents); CHKERRQ(ierr);
+        ierr = UMDestroy(&mesh); CHKERRQ(ierr);
+        mesh = fine;
+    }
+    ierr = UMStats(&mesh, &h_max, NULL, NULL, NULL); CHKERRQ(ierr);
     PetscLogStagePop();
 
     if (viewmesh) {
@@ -175,39 +429,107 @@ int main(int argc,char **argv) {
     }
 
     PetscLogStagePush(user.setupstage);
+    if (geomcache) {
+        ierr = UMSetUpGeometryCache(&mesh,user.gD_fcn); CHKERRQ(ierr);
+    }
+    if (color) {
+        ierr = UMColorElements(&mesh); CHKERRQ(ierr);
+    }
+    if (user.order == 2) {
+        ierr = SetUpP2(&user); CHKERRQ(ierr);
+    }
 //STARTMAININITIAL
-    // configure Vecs
-    ierr = VecCreate(PETSC_COMM_WORLD,&r); CHKERRQ(ierr);
-    ierr = VecSetSizes(r,PETSC_DECIDE,mesh.N); CHKERRQ(ierr);
-    ierr = VecSetFromOptions(r); CHKERRQ(ierr);
+    // configure Vecs; these are ghosted according to mesh partition
+    if (user.order == 2) {
+        ierr = VecCreate(PETSC_COMM_WORLD,&r); CHKERRQ(ierr);
+        ierr = VecSetSizes(r,user.N2,user.N2); CHKERRQ(ierr);
+        ierr = VecSetFromOptions(r); CHKERRQ(ierr);
+    } else {
+        ierr = UMCreateGlobalVec(&mesh,&r); CHKERRQ(ierr);
+    }
     ierr = VecDuplicate(r,&u); CHKERRQ(ierr);
     ierr = VecSet(u,0.0); CHKERRQ(ierr);
+    if (uadapt) {
+        ierr = VecCopy(uadapt,u); CHKERRQ(ierr);
+        ierr = VecDestroy(&uadapt); CHKERRQ(ierr);
+    }
 
     // configure SNES: reset default KSP and PC
     ierr = SNESCreate(PETSC_COMM_WORLD,&snes); CHKERRQ(ierr);
-    ierr = SNESSetFunction(snes,r,FormFunction,&user); CHKERRQ(ierr);
+    ierr = SNESSetFunction(snes,r,
+                           (user.order == 2) ? FormFunctionP2 : FormFunction,
+                           &user); CHKERRQ(ierr);
     ierr = SNESGetKSP(snes,&ksp); CHKERRQ(ierr);
-    ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
     ierr = KSPGetPC(ksp,&pc); CHKERRQ(ierr);
-    ierr = PCSetType(pc,PCICC); CHKERRQ(ierr);
+    // ICC/ILU are serial only; in parallel use the block Jacobi default
+    if (jactype == PICARD) {
+        ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
+        ierr = PCSetType(pc,(size == 1) ? PCICC : PCBJACOBI); CHKERRQ(ierr);
+    } else {  // Newton matrix is not symmetric if da/du or df/du nonzero
+        ierr = KSPSetType(ksp,KSPGMRES); CHKERRQ(ierr);
+        ierr = PCSetType(pc,(size == 1) ? PCILU : PCBJACOBI); CHKERRQ(ierr);
+    }
 
-    // setup matrix for Picard iteration, including preallocation
-    ierr = MatCreate(PETSC_COMM_WORLD,&A); CHKERRQ(ierr);
-    ierr = MatSetSizes(A,PETSC_DECIDE,PETSC_DECIDE,mesh.N,mesh.N); CHKERRQ(ierr);
-    ierr = MatSetFromOptions(A); CHKERRQ(ierr);
-    ierr = MatSetOption(A,MAT_SYMMETRIC,PETSC_TRUE); CHKERRQ(ierr);
-    // Preallocation and setting the nonzero (sparsity) pattern is
-    //   recommended; setting the pattern allows finite difference
-    //   approximation of the Jacobian using coloring.  Option
-    //   -un_noprealloc reveals the poor performance otherwise.
-    if (noprealloc) {
-        ierr = MatSetUp(A); CHKERRQ(ierr);
+    // geometric multigrid with Galerkin coarse operators
+    if (gmglevels > 1) {
+        ierr = PCSetType(pc,PCMG); CHKERRQ(ierr);
+        ierr = PCMGSetLevels(pc,gmglevels,NULL); CHKERRQ(ierr);
+        for (j = 1; j < gmglevels; j++) {
+            ierr = PCMGSetInterpolation(pc,j,gmgP[j]); CHKERRQ(ierr);
+            ierr = MatDestroy(&(gmgP[j])); CHKERRQ(ierr);
+        }
+        ierr = PetscFree(gmgP); CHKERRQ(ierr);
+        ierr = PCMGSetGalerkin(pc,PC_MG_GALERKIN_BOTH); CHKERRQ(ierr);
+    }
+
+    // multigrid with a GAMG hierarchy saved by an earlier run on this mesh;
+    //   only the Galerkin coarse operators are computed
+    if (strlen(loadhier) > 0) {
+        ierr = LoadHierarchy(pc,&mesh,reorder,loadhier,u); CHKERRQ(ierr);
+    }
+
+    if (matfree) {
+        // Picard operator as a MatShell; preconditioner uses its diagonal
+        ierr = MatFreeCreate(&user,&mf,&A); CHKERRQ(ierr);
+        ierr = PCSetType(pc,PCJACOBI); CHKERRQ(ierr);
+        ierr = SNESSetJacobian(snes,A,A,FormMatFree,&mf); CHKERRQ(ierr);
     } else {
-        ierr = PreallocateAndSetNonzeros(A,&user); CHKERRQ(ierr);
+        // setup matrix for Picard iteration, including preallocation
+        ierr = MatCreate(PETSC_COMM_WORLD,&A); CHKERRQ(ierr);
+        if (user.order == 2) {
+            ierr = MatSetSizes(A,user.N2,user.N2,user.N2,user.N2); CHKERRQ(ierr);
+        } else {
+            ierr = MatSetSizes(A,mesh.Nown,mesh.Nown,mesh.N,mesh.N); CHKERRQ(ierr);
+        }
+        ierr = MatSetFromOptions(A); CHKERRQ(ierr);
+        ierr = MatSetOption(A,MAT_SYMMETRIC,
+                            (jactype == PICARD) ? PETSC_TRUE : PETSC_FALSE); CHKERRQ(ierr);
+        // P1 assembly uses local node numbers
+        if (user.order == 1) {
+            ierr = MatSetLocalToGlobalMapping(A,mesh.ltog,mesh.ltog); CHKERRQ(ierr);
+        }
+        // Preallocation and setting the nonzero (sparsity) pattern is
+        //   recommended; setting the pattern allows finite difference
+        //   approximation of the Jacobian using coloring.  Option
+        //   -un_noprealloc reveals the poor performance otherwise.
+        //   For a SeqAIJ matrix the pattern is built directly in CSR form
+        //   unless -un_csr false.
+        ierr = PetscObjectTypeCompare((PetscObject)A,MATSEQAIJ,&isseqaij); CHKERRQ(ierr);
+        if (noprealloc) {
+            ierr = MatSetUp(A); CHKERRQ(ierr);
+        } else if (user.order == 2) {
+            ierr = PreallocateP2(A,&user); CHKERRQ(ierr);
+        } else if (csr && isseqaij) {
+            ierr = PreallocateCSR(A,&user); CHKERRQ(ierr);
+        } else {
+            ierr = PreallocateAndSetNonzeros(A,&user); CHKERRQ(ierr);
+        }
+        // The following call-back is ignored under option -snes_fd or
+        //   -snes_fd_color.  Both matrices have the same nonzero pattern.
+        ierr = SNESSetJacobian(snes,A,A,
+                               (jactype == PICARD) ? FormPicard : FormJacobian,
+                               &user); CHKERRQ(ierr);
     }
-    // The following call-back is ignored under option -snes_fd or
-    //   -snes_fd_color.
-    ierr = SNESSetJacobian(snes,A,A,FormPicard,&user); CHKERRQ(ierr);
     ierr = SNESSetFromOptions(snes); CHKERRQ(ierr);
     PetscLogStagePop();  //STRIP
 
@@ -258,6 +580,22 @@ int main(int argc,char **argv) {
         ierr = MatView(pint,viewer); CHKERRQ(ierr);
     }
 
+    // save all interpolations from GAMG if requested
+    if (strlen(savehier) > 0) {
+        if (strcmp(pctype,"gamg") != 0) {
+            SETERRQ(PETSC_COMM_SELF,4,"option -un_gamg_save_hierarchy set but PC is not of type PCGAMG");
+        }
+        ierr = SaveHierarchy(pc,&mesh,reorder,savehier); CHKERRQ(ierr);
+    }
+
+    // save mesh and solution in VTK XML format if requested; for P2 the
+    //   values at mesh nodes come first in u
+    if (strlen(vtuname) > 0) {
+        ierr = PetscPrintf(PETSC_COMM_WORLD,
+                   "writing mesh and solution in VTK XML format to %s ...\n",vtuname); CHKERRQ(ierr);
+        ierr = UMViewVTU(&mesh,vtuname,u); CHKERRQ(ierr);
+    }
+
     // if exact solution available, report numerical error
     if (user.uexact_fcn) {
         ierr = VecDuplicate(r,&uexact); CHKERRQ(ierr);
@@ -266,12 +604,14 @@ int main(int argc,char **argv) {
         ierr = VecNorm(u,NORM_INFINITY,&err); CHKERRQ(ierr);
         ierr = PetscPrintf(PETSC_COMM_WORLD,
                    "case %d result for N=%d nodes with h = %.3e: |u-u_ex|_inf = %.2e\n",
-                   user.solncase,mesh.N,h_max,err); CHKERRQ(ierr);
+                   user.solncase,(user.order == 2) ? user.N2 : mesh.N,
+                   h_max,err); CHKERRQ(ierr);
         VecDestroy(&uexact);
     } else {
         ierr = PetscPrintf(PETSC_COMM_WORLD,
                    "case %d result for N=%d nodes with h = %.3e ... done\n",
-                   user.solncase,mesh.N,h_max); CHKERRQ(ierr);
+                   user.solncase,(user.order == 2) ? user.N2 : mesh.N,
+                   h_max); CHKERRQ(ierr);
     }
 
     // save solution in PETSc binary if requested
@@ -280,12 +620,27 @@ int main(int argc,char **argv) {
         strncat(solnname, ".soln", 6);
         ierr = PetscPrintf(PETSC_COMM_WORLD,
                    "writing solution in binary format to %s ...\n",solnname); CHKERRQ(ierr);
-        ierr = UMViewSolutionBinary(&mesh,solnname,u); CHKERRQ(ierr);
+        if (user.order == 2) {  // write values at mesh nodes, which come first
+            Vec        uvert;
+            PetscReal  *au;
+            ierr = VecGetArray(u,&au); CHKERRQ(ierr);
+            ierr = VecCreateMPIWithArray(PETSC_COMM_WORLD,1,mesh.N,mesh.N,au,&uvert); CHKERRQ(ierr);
+            ierr = UMViewSolutionBinary(&mesh,solnname,uvert); CHKERRQ(ierr);
+            ierr = VecDestroy(&uvert); CHKERRQ(ierr);
+            ierr = VecRestoreArray(u,&au); CHKERRQ(ierr);
+        } else {
+            ierr = UMViewSolutionBinary(&mesh,solnname,u); CHKERRQ(ierr);
+        }
     }
 
     // clean-up
     VecDestroy(&u);  VecDestroy(&r);
     MatDestroy(&A);  SNESDestroy(&snes);  UMDestroy(&mesh);
+    PetscFree(user.eoff);
+    PetscFree3(user.e2,user.bf2,user.loc2);
+    if (matfree) {
+        MatFreeDestroy(&mf);
+    }
     return PetscFinalize();
 }
 
@@ -296,8 +651,13 @@ PetscErrorCode FillExact(Vec uexact, unfemCtx *ctx) {
     PetscInt     i;
     ierr = UMGetNodeCoordArrayRead(ctx->mesh,&aloc); CHKERRQ(ierr);
     ierr = VecGetArray(uexact,&auexact); CHKERRQ(ierr);
-    for (i = 0; i < ctx->mesh->N; i++) {
-        auexact[i] = ctx->uexact_fcn(aloc[i].x,aloc[i].y);
+    if (ctx->order == 2) {
+        for (i = 0; i < ctx->N2; i++)
+            auexact[i] = ctx->uexact_fcn(ctx->loc2[i].x,ctx->loc2[i].y);
+    } else {
+        for (i = 0; i < ctx->mesh->Nown; i++) {
+            auexact[i] = ctx->uexact_fcn(aloc[i].x,aloc[i].y);
+        }
     }
     ierr = VecRestoreArray(uexact,&auexact); CHKERRQ(ierr);
     ierr = UMRestoreNodeCoordArrayRead(ctx->mesh,&aloc); CHKERRQ(ierr);
@@ -308,29 +668,148 @@ PetscReal InnerProd(const PetscReal V[2], const PetscReal W[2]) {
     return V[0] * W[0] + V[1] * W[1];
 }
 
+// Dirichlet value at local node n, from the geometry cache if available
+PetscReal DirichletValue(unfemCtx *user, const Node *aloc, PetscInt n) {
+    if (user->mesh->geom && user->mesh->geom->gD)
+        return user->mesh->geom->gD[n];
+    return user->gD_fcn(aloc[n].x,aloc[n].y);
+}
+
+// element geometry and hat function gradients, from the geometry cache if
+//   available; en[0], en[1], en[2] are the nodes of element k
+void ElementGeometry(UM *mesh, PetscInt k, const PetscInt *en,
+                     const Node *aloc, PetscReal *x0, PetscReal *y0,
+                     PetscReal *dx1, PetscReal *dx2, PetscReal *dy1,
+                     PetscReal *dy2, PetscReal *detJ,
+                     PetscReal gradpsi[3][2]) {
+    const UMGeometryCache *g = mesh->geom;
+    PetscInt  l;
+    if (g) {
+        *x0 = g->x0[k];    *y0 = g->y0[k];
+        *dx1 = g->dx1[k];  *dx2 = g->dx2[k];
+        *dy1 = g->dy1[k];  *dy2 = g->dy2[k];
+        *detJ = g->detJ[k];
+        for (l = 0; l < 3; l++) {
+            gradpsi[l][0] = g->gx[l][k];
+            gradpsi[l][1] = g->gy[l][k];
+        }
+        return;
+    }
+    *x0 = aloc[en[0]].x;
+    *y0 = aloc[en[0]].y;
+    *dx1 = aloc[en[1]].x - aloc[en[0]].x;
+    *dx2 = aloc[en[2]].x - aloc[en[0]].x;
+    *dy1 = aloc[en[1]].y - aloc[en[0]].y;
+    *dy2 = aloc[en[2]].y - aloc[en[0]].y;
+    *detJ = (*dx1) * (*dy2) - (*dx2) * (*dy1);
+    for (l = 0; l < 3; l++) {
+        gradpsi[l][0] = ( (*dy2) * dchi[l][0] - (*dy1) * dchi[l][1]) / (*detJ);
+        gradpsi[l][1] = (-(*dx2) * dchi[l][0] + (*dx1) * dchi[l][1]) / (*detJ);
+    }
+}
+
 //STARTRESIDUAL
+#define RESBLOCK 32   // elements per block in BlockResidual()
+
+/* Add the residual contributions of nb <= RESBLOCK elements into aF; the
+elements are klist[0..nb-1], or k0,...,k0+nb-1 if klist is null.  Values of u
+and (x,y) at all quadrature points of the block are gathered into buffers so
+that a(u,x,y) and f(u,x,y) are evaluated by one call each to a_batch and
+f_batch if these are given; otherwise a_fcn and f_fcn are called pointwise.
+Touches only entries of aF at nodes of these elements. */
+static void BlockResidual(unfemCtx *user, const Quad2DTri *qq,
+                          const PetscInt *ae, const PetscInt *abf,
+                          const Node *aloc, const PetscReal *au,
+                          PetscInt nb, const PetscInt *klist, PetscInt k0,
+                          PetscReal *aF) {
+    const Quad2DTri  q = *qq;
+    const PetscInt   *en;
+    PetscInt         b, k, l, r, i, npts = nb * q.n;
+    PetscReal        unode[3], x0, y0, dx1, dx2, dy1, dy2, psi, ip, sum,
+                     detJ[RESBLOCK], gradu[RESBLOCK][2], gradpsi[RESBLOCK][3][2],
+                     ub[MAXPTS_TRI*RESBLOCK], xb[MAXPTS_TRI*RESBLOCK],
+                     yb[MAXPTS_TRI*RESBLOCK], ab[MAXPTS_TRI*RESBLOCK],
+                     fb[MAXPTS_TRI*RESBLOCK];
+
+    // gather; quadrature point r of block element b is at i = b*q.n + r
+    for (b = 0; b < nb; b++) {
+        k = (klist) ? klist[b] : k0 + b;
+        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
+        ElementGeometry(user->mesh,k,en,aloc,&x0,&y0,&dx1,&dx2,&dy1,&dy2,
+                        &(detJ[b]),gradpsi[b]);
+        // u and grad u on element
+        gradu[b][0] = 0.0;
+        gradu[b][1] = 0.0;
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] == 2)  // enforces symmetry
+                unode[l] = DirichletValue(user,aloc,en[l]);
+            else
+                unode[l] = au[en[l]];
+            gradu[b][0] += unode[l] * gradpsi[b][l][0];
+            gradu[b][1] += unode[l] * gradpsi[b][l][1];
+        }
+        for (r = 0; r < q.n; r++) {
+            i = b * q.n + r;
+            ub[i] = evalq(user,unode,r);
+            xb[i] = x0 + dx1 * q.xi[r] + dx2 * q.eta[r];
+            yb[i] = y0 + dy1 * q.xi[r] + dy2 * q.eta[r];
+        }
+    }
+
+    // function values at all quadrature points of block
+    if (user->a_batch && user->f_batch) {
+        user->a_batch(npts,ub,xb,yb,ab);
+        user->f_batch(npts,ub,xb,yb,fb);
+    } else {
+        for (i = 0; i < npts; i++) {
+            ab[i] = user->a_fcn(ub[i],xb[i],yb[i]);
+            fb[i] = user->f_fcn(ub[i],xb[i],yb[i]);
+        }
+    }
+
+    // residual contribution for each non-Dirichlet node of each element
+    for (b = 0; b < nb; b++) {
+        k = (klist) ? klist[b] : k0 + b;
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] != 2) {
+                sum = 0.0;
+                for (r = 0; r < q.n; r++) {
+                    psi = user->psi[l][r];
+                    ip  = InnerProd(gradu[b],gradpsi[b][l]);
+                    sum += q.w[r] * ( ab[b*q.n+r] * ip - fb[b*q.n+r] * psi );
+                }
+                aF[en[l]] += PetscAbsReal(detJ[b]) * sum;
+            }
+        }
+    }
+}
+
 PetscErrorCode FormFunction(SNES snes, Vec u, Vec F, void *ctx) {
     PetscErrorCode ierr;
     unfemCtx         *user = (unfemCtx*)ctx;
     const Quad2DTri  q = symmgauss[user->quaddegree-1];
-    const PetscInt   *ae, *ans, *abf, *en;
+    const PetscInt   *ae, *ans, *abf;
     const Node       *aloc;
     const PetscReal  *au;
-    PetscInt         p, na, nb, k, l, r;
-    PetscReal        *aF, unode[3], gradu[2], gradpsi[3][2], uquad[4],
-                     aquad[4], fquad[4], dx, dy, dx1, dx2, dy1, dy2,
-                     detJ, ls, xmid, ymid, sint, xx, yy, psi, ip, sum;
+    Vec              ul, Fl;
+    PetscInt         p, na, nb, k, c, j, cend, n;
+    PetscReal        *aF, dx, dy, ls, xmid, ymid, sint;
 
     PetscLogStagePush(user->resstage);  //STRIP
-    ierr = VecSet(F,0.0); CHKERRQ(ierr);
-    ierr = VecGetArray(F,&aF); CHKERRQ(ierr);
+    // get ghost values of u; sum into F from ghosts at the end
+    ierr = UMVecGhostUpdate(user->mesh,u,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(user->mesh,u,&ul); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(user->mesh,F,&Fl); CHKERRQ(ierr);
+    ierr = VecSet(Fl,0.0); CHKERRQ(ierr);
+    ierr = VecGetArray(Fl,&aF); CHKERRQ(ierr);
     ierr = UMGetNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
     ierr = ISGetIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
 
     // Neumann boundary segment contributions (if any)
     if (user->mesh->P > 0) {
         ierr = ISGetIndices(user->mesh->ns,&ans); CHKERRQ(ierr);
-        for (p = 0; p < user->mesh->P; p++) {
+        for (p = 0; p < user->mesh->Pown; p++) {
             na = ans[2*p+0];  nb = ans[2*p+1];  // end nodes of segment
             dx = aloc[na].x-aloc[nb].x;  dy = aloc[na].y-aloc[nb].y;
             ls = sqrt(dx * dx + dy * dy);  // length of segment
@@ -347,62 +826,43 @@ PetscErrorCode FormFunction(SNES snes, Vec u, Vec F, void *ctx) {
         ierr = ISRestoreIndices(user->mesh->ns,&ans); CHKERRQ(ierr);
     }
 
-    // element contributions and Dirichlet node residuals
-    ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
+    // element contributions
+    ierr = VecGetArrayRead(ul,&au); CHKERRQ(ierr);
     ierr = ISGetIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    for (k = 0; k < user->mesh->K; k++) {
-        // element geometry and hat function gradients
-        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        dx1 = aloc[en[1]].x - aloc[en[0]].x;
-        dx2 = aloc[en[2]].x - aloc[en[0]].x;
-        dy1 = aloc[en[1]].y - aloc[en[0]].y;
-        dy2 = aloc[en[2]].y - aloc[en[0]].y;
-        detJ = dx1 * dy2 - dx2 * dy1;
-        for (l = 0; l < 3; l++) {
-            gradpsi[l][0] = ( dy2 * dchi[l][0] - dy1 * dchi[l][1]) / detJ;
-            gradpsi[l][1] = (-dx2 * dchi[l][0] + dx1 * dchi[l][1]) / detJ;
-        }
-        // u and grad u on element
-        gradu[0] = 0.0;
-        gradu[1] = 0.0;
-        for (l = 0; l < 3; l++) {
-            if (abf[en[l]] == 2)  // enforces symmetry
-                unode[l] = user->gD_fcn(aloc[en[l]].x,aloc[en[l]].y);
-            else
-                unode[l] = au[en[l]];
-            gradu[0] += unode[l] * gradpsi[l][0];
-            gradu[1] += unode[l] * gradpsi[l][1];
-        }
-        // function values at quadrature points on element
-        for (r = 0; r < q.n; r++) {
-            uquad[r] = eval(unode,q.xi[r],q.eta[r]);
-            xx = aloc[en[0]].x + dx1 * q.xi[r] + dx2 * q.eta[r];
-            yy = aloc[en[0]].y + dy1 * q.xi[r] + dy2 * q.eta[r];
-            aquad[r] = user->a_fcn(uquad[r],xx,yy);
-            fquad[r] = user->f_fcn(uquad[r],xx,yy);
+    if (user->mesh->colorptr) {
+        // elements of one color share no node, so threads do not collide
+        for (c = 0; c < user->mesh->ncolors; c++) {
+            cend = user->mesh->colorptr[c+1];
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+            for (j = user->mesh->colorptr[c]; j < cend; j += RESBLOCK)
+                BlockResidual(user,&q,ae,abf,aloc,au,PetscMin(RESBLOCK,cend-j),
+                              user->mesh->colorelts + j,0,aF);
         }
-        // residual contribution for each node of element
-        for (l = 0; l < 3; l++) {
-            if (abf[en[l]] == 2) { // set Dirichlet residual
-                xx = aloc[en[l]].x;   yy = aloc[en[l]].y;
-                aF[en[l]] = au[en[l]] - user->gD_fcn(xx,yy);
-            } else {
-                sum = 0.0;
-                for (r = 0; r < q.n; r++) {
-                    psi = chi(l,q.xi[r],q.eta[r]);
-                    ip  = InnerProd(gradu,gradpsi[l]);
-                    sum += q.w[r] * ( aquad[r] * ip - fquad[r] * psi );
-                }
-                aF[en[l]] += PetscAbsReal(detJ) * sum;
-            }
+    } else {
+        for (k = 0; k < user->mesh->Kown; k += RESBLOCK)
+            BlockResidual(user,&q,ae,abf,aloc,au,
+                          PetscMin(RESBLOCK,user->mesh->Kown-k),NULL,k,aF);
+    }
+    ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VecRestoreArray(Fl,&aF); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(user->mesh,F,&Fl); CHKERRQ(ierr);
+    ierr = UMVecGhostUpdate(user->mesh,F,ADD_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+
+    // set Dirichlet residuals at owned nodes
+    ierr = VecGetArray(F,&aF); CHKERRQ(ierr);
+    for (n = 0; n < user->mesh->Nown; n++) {
+        if (abf[n] == 2) {
+            aF[n] = au[n] - DirichletValue(user,aloc,n);
         }
     }
+    ierr = VecRestoreArray(F,&aF); CHKERRQ(ierr);
 
-    ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(ul,&au); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(user->mesh,u,&ul); CHKERRQ(ierr);
     ierr = ISRestoreIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
     ierr = UMRestoreNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
-    ierr = VecRestoreArray(F,&aF); CHKERRQ(ierr);
     PetscLogStagePop();  //STRIP
     return 0;
 }
@@ -410,79 +870,175 @@ PetscErrorCode FormFunction(SNES snes, Vec u, Vec F, void *ctx) {
 
 
 //STARTPICARD
-PetscErrorCode FormPicard(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
+// compute the element matrix of element k, rows and columns at its
+//   non-Dirichlet nodes only; row[0..*ncr-1] are these nodes and v is the
+//   (*ncr) x (*ncr) matrix in row-major order
+static void ElementMatrix(unfemCtx *user, const Quad2DTri *qq,
+                          const PetscInt *ae, const PetscInt *abf,
+                          const Node *aloc, const PetscReal *au, PetscInt k,
+                          PetscBool newton, PetscInt *ncr, PetscInt row[3],
+                          PetscReal v[9]) {
+    const Quad2DTri  q = *qq;
+    const PetscInt   *en;
+    PetscInt         l, m, r, cr, cv;
+    PetscReal        unode[3], gradu[2], gradpsi[3][2], uquad[MAXPTS_TRI],
+                     aquad[MAXPTS_TRI], daquad[MAXPTS_TRI], dfquad[MAXPTS_TRI], x0, y0, dx1, dx2, dy1, dy2, detJ,
+                     xx, yy, sum, psil, psim;
+
+    en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
+    // geometry of element and gradients of hat functions
+    ElementGeometry(user->mesh,k,en,aloc,&x0,&y0,&dx1,&dx2,&dy1,&dy2,
+                    &detJ,gradpsi);
+    // u and grad u on element
+    gradu[0] = 0.0;
+    gradu[1] = 0.0;
+    for (l = 0; l < 3; l++) {
+        if (abf[en[l]] == 2)
+            unode[l] = DirichletValue(user,aloc,en[l]);
+        else
+            unode[l] = au[en[l]];
+        gradu[0] += unode[l] * gradpsi[l][0];
+        gradu[1] += unode[l] * gradpsi[l][1];
+    }
+    // function values at quadrature points on element
+    for (r = 0; r < q.n; r++) {
+        uquad[r] = evalq(user,unode,r);
+        xx = x0 + dx1 * q.xi[r] + dx2 * q.eta[r];
+        yy = y0 + dy1 * q.xi[r] + dy2 * q.eta[r];
+        aquad[r] = user->a_fcn(uquad[r],xx,yy);
+        if (newton) {
+            daquad[r] = user->da_fcn(uquad[r],xx,yy);
+            dfquad[r] = user->df_fcn(uquad[r],xx,yy);
+        }
+    }
+    // generate 3x3 element stiffness matrix (may be smaller)
+    cr = 0;  cv = 0;  // cr = count rows; cv = entry counter
+    for (l = 0; l < 3; l++) {
+        if (abf[en[l]] != 2) {
+            row[cr++] = en[l];
+            for (m = 0; m < 3; m++) {
+                if (abf[en[m]] != 2) {
+                    sum = 0.0;
+                    for (r = 0; r < q.n; r++) {
+                        sum += q.w[r] * aquad[r]
+                               * InnerProd(gradpsi[l],gradpsi[m]);
+                    }
+                    if (newton) {
+                        for (r = 0; r < q.n; r++) {
+                            psil = user->psi[l][r];
+                            psim = user->psi[m][r];
+                            sum += q.w[r] * psim
+                                   * ( daquad[r] * InnerProd(gradu,gradpsi[l])
+                                       - dfquad[r] * psil );
+                        }
+                    }
+                    v[cv++] = PetscAbsReal(detJ) * sum;
+                }
+            }
+        }
+    }
+    *ncr = cr;
+}
+
+/* Assemble the Picard matrix, which freezes a(u,x,y) at the current iterate,
+   P_lm = int a(u) grad psi_m . grad psi_l,
+or, if newton is true, the Newton matrix (Jacobian of FormFunction()),
+   J_lm = P_lm + int (da/du) psi_m grad u . grad psi_l - (df/du) psi_m psi_l.
+Rows and columns of Dirichlet nodes are omitted except for a unit diagonal. */
+static PetscErrorCode AssembleMatrix(Vec u, Mat P, unfemCtx *user,
+                                     PetscBool newton) {
     PetscErrorCode ierr;
-    unfemCtx         *user = (unfemCtx*)ctx;
     const Quad2DTri  q = symmgauss[user->quaddegree-1];
-    const PetscInt   *ae, *abf, *en;
+    const PetscInt   *ae, *abf;
     const Node       *aloc;
     const PetscReal  *au;
-    PetscReal        unode[3], gradpsi[3][2], uquad[4], aquad[4], v[9],
-                     dx1, dx2, dy1, dy2, detJ, xx, yy, sum;
-    PetscInt         n, k, l, m, r, cr, cv, row[3];
+    Vec              ul;
+    PetscReal        v[9], *aa = NULL;
+    PetscInt         n, k, l, c, j, cr, cv, row[3], nz, *eoff = user->eoff;
 
-    PetscLogStagePush(user->jacstage);  //STRIP
-    ierr = MatZeroEntries(P); CHKERRQ(ierr);
+    if (user->order == 2) {
+        ierr = AssembleMatrixP2(u,P,user,newton); CHKERRQ(ierr);
+        return 0;
+    }
     ierr = ISGetIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
-    for (n = 0; n < user->mesh->N; n++) {
-        if (abf[n] == 2) {
-            v[0] = 1.0;
-            ierr = MatSetValues(P,1,&n,1,&n,v,ADD_VALUES); CHKERRQ(ierr);
+    if (eoff) {
+        // direct path: Dirichlet rows hold only the diagonal, at the start
+        //   of the row; see PreallocateCSR()
+        const PetscInt *ia, *ja;
+        PetscInt       nrows;
+        PetscBool      done;
+        ierr = MatGetRowIJ(P,0,PETSC_FALSE,PETSC_FALSE,&nrows,&ia,&ja,&done); CHKERRQ(ierr);
+        nz = ia[nrows];
+        ierr = MatSeqAIJGetArray(P,&aa); CHKERRQ(ierr);
+        ierr = PetscArrayzero(aa,nz); CHKERRQ(ierr);
+        for (n = 0; n < nrows; n++) {
+            if (abf[n] == 2)
+                aa[ia[n]] = 1.0;
+        }
+        ierr = MatRestoreRowIJ(P,0,PETSC_FALSE,PETSC_FALSE,&nrows,&ia,&ja,&done); CHKERRQ(ierr);
+    } else {
+        ierr = MatZeroEntries(P); CHKERRQ(ierr);
+        for (n = 0; n < user->mesh->Nown; n++) {
+            if (abf[n] == 2) {
+                v[0] = 1.0;
+                ierr = MatSetValuesLocal(P,1,&n,1,&n,v,ADD_VALUES); CHKERRQ(ierr);
+            }
         }
     }
     ierr = ISGetIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = UMVecGhostUpdate(user->mesh,u,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(user->mesh,u,&ul); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(ul,&au); CHKERRQ(ierr);
     ierr = UMGetNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
-    for (k = 0; k < user->mesh->K; k++) {
-        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        // geometry of element
-        dx1 = aloc[en[1]].x - aloc[en[0]].x;
-        dx2 = aloc[en[2]].x - aloc[en[0]].x;
-        dy1 = aloc[en[1]].y - aloc[en[0]].y;
-        dy2 = aloc[en[2]].y - aloc[en[0]].y;
-        detJ = dx1 * dy2 - dx2 * dy1;
-        // gradients of hat functions and u on element
-        for (l = 0; l < 3; l++) {
-            gradpsi[l][0] = ( dy2 * dchi[l][0] - dy1 * dchi[l][1]) / detJ;
-            gradpsi[l][1] = (-dx2 * dchi[l][0] + dx1 * dchi[l][1]) / detJ;
-            if (abf[en[l]] == 2)
-                unode[l] = user->gD_fcn(aloc[en[l]].x,aloc[en[l]].y);
-            else
-                unode[l] = au[en[l]];
-        }
-        // function values at quadrature points on element
-        for (r = 0; r < q.n; r++) {
-            uquad[r] = eval(unode,q.xi[r],q.eta[r]);
-            xx = aloc[en[0]].x + dx1 * q.xi[r] + dx2 * q.eta[r];
-            yy = aloc[en[0]].y + dy1 * q.xi[r] + dy2 * q.eta[r];
-            aquad[r] = user->a_fcn(uquad[r],xx,yy);
+    if (eoff && user->mesh->colorptr) {
+        // elements of one color share no node, thus no row of the matrix
+        for (c = 0; c < user->mesh->ncolors; c++) {
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static) private(k,l,cv,cr,row,v)
+#endif
+            for (j = user->mesh->colorptr[c]; j < user->mesh->colorptr[c+1]; j++) {
+                k = user->mesh->colorelts[j];
+                ElementMatrix(user,&q,ae,abf,aloc,au,k,newton,&cr,row,v);
+                cv = 0;
+                for (l = 0; l < 9; l++) {
+                    if (eoff[9*k+l] >= 0)
+                        aa[eoff[9*k+l]] += v[cv++];
+                }
+            }
         }
-        // generate 3x3 element stiffness matrix (may be smaller)
-        cr = 0;  cv = 0;  // cr = count rows; cv = entry counter
-        for (l = 0; l < 3; l++) {
-            if (abf[en[l]] != 2) {
-                row[cr++] = en[l];
-                for (m = 0; m < 3; m++) {
-                    if (abf[en[m]] != 2) {
-                        sum = 0.0;
-                        for (r = 0; r < q.n; r++) {
-                            sum += q.w[r] * aquad[r]
-                                   * InnerProd(gradpsi[l],gradpsi[m]);
-                        }
-                        v[cv++] = PetscAbsReal(detJ) * sum;
-                    }
+    } else {
+        for (k = 0; k < user->mesh->Kown; k++) {
+            ElementMatrix(user,&q,ae,abf,aloc,au,k,newton,&cr,row,v);
+            if (eoff) {  // scatter straight into value array
+                cv = 0;
+                for (l = 0; l < 9; l++) {
+                    if (eoff[9*k+l] >= 0)
+                        aa[eoff[9*k+l]] += v[cv++];
                 }
+            } else {
+                ierr = MatSetValuesLocal(P,cr,row,cr,row,v,ADD_VALUES); CHKERRQ(ierr);
             }
         }
-        ierr = MatSetValues(P,cr,row,cr,row,v,ADD_VALUES); CHKERRQ(ierr);
     }
     ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
     ierr = ISRestoreIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
-    ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(ul,&au); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(user->mesh,u,&ul); CHKERRQ(ierr);
     ierr = UMRestoreNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
+    if (eoff) {
+        ierr = MatSeqAIJRestoreArray(P,&aa); CHKERRQ(ierr);
+    }
 
     ierr = MatAssemblyBegin(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
     ierr = MatAssemblyEnd(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode FormPicard(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx *user = (unfemCtx*)ctx;
+    PetscLogStagePush(user->jacstage);  //STRIP
+    ierr = AssembleMatrix(u,P,user,PETSC_FALSE); CHKERRQ(ierr);
     if (A != P) {
         ierr = MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
         ierr = MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
@@ -492,6 +1048,191 @@ PetscErrorCode FormPicard(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
 }
 //ENDPICARD
 
+PetscErrorCode FormJacobian(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx *user = (unfemCtx*)ctx;
+    PetscLogStagePush(user->jacstage);  //STRIP
+    ierr = AssembleMatrix(u,P,user,PETSC_TRUE); CHKERRQ(ierr);
+    if (A != P) {
+        ierr = MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    PetscLogStagePop();  //STRIP
+    return 0;
+}
+
+
+/* Matrix-free application of the Picard operator.  Because the hat function
+gradients are constant on each element, the element matrix of FormPicard() is
+c_k grad psi_m . grad psi_l, where c_k = |det J| sum_r w_r a(u(xi_r,eta_r)).
+Thus only one number per element needs to be stored between MatMult()s; the
+geometry comes from the UM geometry cache if present and is otherwise
+recomputed.  Dirichlet rows and columns are treated as in FormPicard(). */
+static PetscErrorCode MatMult_MatFree(Mat A, Vec x, Vec y) {
+    PetscErrorCode ierr;
+    matfreeCtx       *mf;
+    UM               *mesh;
+    const PetscInt   *ae, *abf, *en;
+    const Node       *aloc;
+    const PetscReal  *ax;
+    PetscReal        *ay, gradx[2], gradpsi[3][2],
+                     x0, y0, dx1, dx2, dy1, dy2, detJ;
+    Vec              xl, yl;
+    PetscInt         k, l, n;
+
+    ierr = MatShellGetContext(A,&mf); CHKERRQ(ierr);
+    mesh = mf->user->mesh;
+    // x, y come from KSP and need not be ghosted
+    ierr = VecCopy(x,mf->xg); CHKERRQ(ierr);
+    ierr = UMVecGhostUpdate(mesh,mf->xg,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(mesh,mf->xg,&xl); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(mesh,mf->yg,&yl); CHKERRQ(ierr);
+    ierr = VecSet(yl,0.0); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(xl,&ax); CHKERRQ(ierr);
+    ierr = VecGetArray(yl,&ay); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (k = 0; k < mesh->Kown; k++) {
+        en = ae + 3*k;
+        ElementGeometry(mesh,k,en,aloc,&x0,&y0,&dx1,&dx2,&dy1,&dy2,
+                        &detJ,gradpsi);
+        gradx[0] = 0.0;
+        gradx[1] = 0.0;
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] != 2) {
+                gradx[0] += ax[en[l]] * gradpsi[l][0];
+                gradx[1] += ax[en[l]] * gradpsi[l][1];
+            }
+        }
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] != 2)
+                ay[en[l]] += mf->coef[k] * InnerProd(gradx,gradpsi[l]);
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArray(yl,&ay); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(mesh,mf->yg,&yl); CHKERRQ(ierr);
+    ierr = UMVecGhostUpdate(mesh,mf->yg,ADD_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+
+    // unit diagonal in Dirichlet rows
+    ierr = VecGetArray(mf->yg,&ay); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++) {
+        if (abf[n] == 2)
+            ay[n] = ax[n];
+    }
+    ierr = VecRestoreArray(mf->yg,&ay); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(xl,&ax); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(mesh,mf->xg,&xl); CHKERRQ(ierr);
+    ierr = VecCopy(mf->yg,y); CHKERRQ(ierr);
+    return 0;
+}
+
+static PetscErrorCode MatGetDiagonal_MatFree(Mat A, Vec d) {
+    PetscErrorCode ierr;
+    matfreeCtx *mf;
+    ierr = MatShellGetContext(A,&mf); CHKERRQ(ierr);
+    ierr = VecCopy(mf->diag,d); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode MatFreeCreate(unfemCtx *user, matfreeCtx *mf, Mat *A) {
+    PetscErrorCode ierr;
+    UM *mesh = user->mesh;
+    mf->user = user;
+    ierr = PetscMalloc1(mesh->Kown,&(mf->coef)); CHKERRQ(ierr);
+    ierr = UMCreateGlobalVec(mesh,&(mf->xg)); CHKERRQ(ierr);
+    ierr = VecDuplicate(mf->xg,&(mf->yg)); CHKERRQ(ierr);
+    ierr = VecDuplicate(mf->xg,&(mf->diag)); CHKERRQ(ierr);
+    ierr = MatCreateShell(PETSC_COMM_WORLD,mesh->Nown,mesh->Nown,mesh->N,mesh->N,
+                          mf,A); CHKERRQ(ierr);
+    ierr = MatShellSetOperation(*A,MATOP_MULT,
+                                (void(*)(void))MatMult_MatFree); CHKERRQ(ierr);
+    ierr = MatShellSetOperation(*A,MATOP_GET_DIAGONAL,
+                                (void(*)(void))MatGetDiagonal_MatFree); CHKERRQ(ierr);
+    ierr = MatSetOption(*A,MAT_SYMMETRIC,PETSC_TRUE); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode MatFreeDestroy(matfreeCtx *mf) {
+    PetscErrorCode ierr;
+    ierr = PetscFree(mf->coef); CHKERRQ(ierr);
+    ierr = VecDestroy(&(mf->xg)); CHKERRQ(ierr);
+    ierr = VecDestroy(&(mf->yg)); CHKERRQ(ierr);
+    ierr = VecDestroy(&(mf->diag)); CHKERRQ(ierr);
+    return 0;
+}
+
+// "Jacobian" call-back for -un_matfree:  freeze a(u) by computing the
+//   per-element coefficients, and assemble the diagonal
+PetscErrorCode FormMatFree(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
+    PetscErrorCode ierr;
+    matfreeCtx       *mf = (matfreeCtx*)ctx;
+    unfemCtx         *user = mf->user;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const PetscInt   *ae, *abf, *en;
+    const Node       *aloc;
+    const PetscReal  *au;
+    Vec              ul, dl;
+    PetscReal        unode[3], gradpsi[3][2], *ad, x0, y0, dx1, dx2, dy1,
+                     dy2, detJ, xx, yy, uquad, sum;
+    PetscInt         n, k, l, r;
+
+    PetscLogStagePush(user->jacstage);  //STRIP
+    ierr = UMVecGhostUpdate(user->mesh,u,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(user->mesh,u,&ul); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(ul,&au); CHKERRQ(ierr);
+    ierr = UMVecGetLocalForm(user->mesh,mf->diag,&dl); CHKERRQ(ierr);
+    ierr = VecSet(dl,0.0); CHKERRQ(ierr);
+    ierr = VecGetArray(dl,&ad); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(user->mesh->e,&ae); CHKERRQ(ierr);
+    for (k = 0; k < user->mesh->Kown; k++) {
+        en = ae + 3*k;
+        ElementGeometry(user->mesh,k,en,aloc,&x0,&y0,&dx1,&dx2,&dy1,&dy2,
+                        &detJ,gradpsi);
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] == 2)
+                unode[l] = DirichletValue(user,aloc,en[l]);
+            else
+                unode[l] = au[en[l]];
+        }
+        sum = 0.0;
+        for (r = 0; r < q.n; r++) {
+            uquad = evalq(user,unode,r);
+            xx = x0 + dx1 * q.xi[r] + dx2 * q.eta[r];
+            yy = y0 + dy1 * q.xi[r] + dy2 * q.eta[r];
+            sum += q.w[r] * user->a_fcn(uquad,xx,yy);
+        }
+        mf->coef[k] = PetscAbsReal(detJ) * sum;
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] != 2)
+                ad[en[l]] += mf->coef[k] * InnerProd(gradpsi[l],gradpsi[l]);
+        }
+    }
+    ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArray(dl,&ad); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(user->mesh,mf->diag,&dl); CHKERRQ(ierr);
+    ierr = UMVecGhostUpdate(user->mesh,mf->diag,ADD_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+    ierr = VecGetArray(mf->diag,&ad); CHKERRQ(ierr);
+    for (n = 0; n < user->mesh->Nown; n++) {
+        if (abf[n] == 2)
+            ad[n] = 1.0;
+    }
+    ierr = VecRestoreArray(mf->diag,&ad); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(ul,&au); CHKERRQ(ierr);
+    ierr = UMVecRestoreLocalForm(user->mesh,u,&ul); CHKERRQ(ierr);
+
+    ierr = MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    PetscLogStagePop();  //STRIP
+    return 0;
+}
 
 /* The following procedure is accomplishes essentially the same actions
 as DMCreateMatrix() when a DM is present.  It first preallocates storage
@@ -500,57 +1241,887 @@ actually sets the sparsity pattern by inserting zeros--ironically--where
 there will be nonzero entries.  This means that -snes_fd_color can be used.
 
 Note that nnz[n] is the number of nonzeros in row n.  In our case it
-equals one for Dirichlet rows, it is one more than the number of incident
-triangles for an interior point, and it is two more than the number of
-incident triangles for Neumann boundary nodes. */
+equals one for Dirichlet rows.  For other rows it is at most one more than
+the number of neighbors of the node, that is, the other nodes of the
+elements containing it, from the adjacency built by UMBuildAdjacency().
+Dirichlet neighbors are counted although their columns are not set.
+
+In parallel each process knows only the neighbors from its owned elements,
+so counts are summed into the owner through a ghosted Vec.  A neighbor is
+thus counted twice if two processes own elements containing both nodes.
+Each count is split into the diagonal block (columns owned by the row
+owner) and the off-diagonal block, and both are capped by the block sizes.
+Thus 1 + dcount and ocount are upper bounds which are sharp for rows with
+no Dirichlet neighbors and whose elements are all owned by one process. */
 //STARTPREALLOC
 PetscErrorCode PreallocateAndSetNonzeros(Mat J, unfemCtx *user) {
     PetscErrorCode ierr;
-    const PetscInt  *ae, *abf, *en;
-    PetscInt        *nnz, n, k, l, cr, row[3];
-    PetscReal       zero = 0.0,
-                    v[9] = {0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0};
+    UM              *mesh = user->mesh;
+    const PetscInt  *abf, *ltogidx, *ranges;
+    PetscInt        *nnz, *onnz, *owner, *col, n, j, m, cc, maxrow, Nloc,
+                    lo, hi;
+    PetscMPIInt     size, rank;
+    PetscReal       *acount, *v, zero = 0.0;
+    Vec             count, countl;
 
-    // preallocate: set number of nonzeros per row
-    ierr = ISGetIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
-    ierr = ISGetIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = PetscMalloc1(user->mesh->N,&nnz); CHKERRQ(ierr);
-    for (n = 0; n < user->mesh->N; n++)
-        nnz[n] = (abf[n] == 1) ? 2 : 1;
-    for (k = 0; k < user->mesh->K; k++) {
-        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        for (l = 0; l < 3; l++)
-            if (abf[en[l]] != 2)
-                nnz[en[l]] += 1;
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    Nloc = mesh->Nown + mesh->Ngh;
+
+    // owning process of each local node, by bisection in the ownership
+    //   ranges of the coordinates (two entries per node)
+    ierr = VecGetOwnershipRanges(mesh->loc,&ranges); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingGetIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+    ierr = PetscMalloc1(Nloc,&owner); CHKERRQ(ierr);
+    for (n = 0; n < Nloc; n++) {
+        if (n < mesh->Nown) {
+            owner[n] = rank;
+        } else {
+            lo = 0;  hi = size;
+            while (hi - lo > 1) {
+                m = (lo + hi) / 2;
+                if (2 * ltogidx[n] >= ranges[m])
+                    lo = m;
+                else
+                    hi = m;
+            }
+            owner[n] = lo;
+        }
+    }
+    ierr = ISLocalToGlobalMappingRestoreIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+
+    // preallocate: count nonzeros per row, as (total,diagonal,off-diagonal),
+    //   from the node-to-node adjacency of the owned elements; summing over
+    //   processes counts a neighbor twice if both own elements with it
+    if (!mesh->nbrptr) {
+        ierr = UMBuildAdjacency(mesh); CHKERRQ(ierr);
+    }
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingGetIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+    ierr = VecCreateGhostBlock(PETSC_COMM_WORLD,3,3*mesh->Nown,3*mesh->N,
+               mesh->Ngh,ltogidx + mesh->Nown,&count); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingRestoreIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+    ierr = VecGhostGetLocalForm(count,&countl); CHKERRQ(ierr);
+    ierr = VecSet(countl,0.0); CHKERRQ(ierr);
+    ierr = VecGetArray(countl,&acount); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++)
+        acount[3*n+0] = 1.0;
+    maxrow = 1;
+    for (n = 0; n < Nloc; n++) {
+        if (abf[n] == 2)
+            continue;
+        maxrow = PetscMax(maxrow,1 + mesh->nbrptr[n+1] - mesh->nbrptr[n]);
+        for (j = mesh->nbrptr[n]; j < mesh->nbrptr[n+1]; j++) {
+            acount[3*n+0] += 1.0;
+            if (owner[mesh->nbrs[j]] == owner[n])
+                acount[3*n+1] += 1.0;
+            else
+                acount[3*n+2] += 1.0;
+        }
     }
+    ierr = VecRestoreArray(countl,&acount); CHKERRQ(ierr);
+    ierr = VecGhostRestoreLocalForm(count,&countl); CHKERRQ(ierr);
+    ierr = VecGhostUpdateBegin(count,ADD_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+    ierr = VecGhostUpdateEnd(count,ADD_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+    ierr = PetscMalloc2(mesh->Nown,&nnz,mesh->Nown,&onnz); CHKERRQ(ierr);
+    ierr = VecGetArray(count,&acount); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++) {
+        nnz[n] = (PetscInt)acount[3*n+0];
+        onnz[n] = PetscMin(nnz[n],(PetscInt)acount[3*n+2]);
+        onnz[n] = PetscMin(onnz[n],mesh->N - mesh->Nown);
+        nnz[n] = PetscMin(nnz[n],1 + (PetscInt)acount[3*n+1]);
+        nnz[n] = PetscMin(nnz[n],mesh->Nown);
+    }
+    ierr = VecRestoreArray(count,&acount); CHKERRQ(ierr);
+    ierr = VecDestroy(&count); CHKERRQ(ierr);
+    ierr = PetscFree(owner); CHKERRQ(ierr);
     ierr = MatSeqAIJSetPreallocation(J,-1,nnz); CHKERRQ(ierr);
-    ierr = PetscFree(nnz); CHKERRQ(ierr);
+    ierr = MatMPIAIJSetPreallocation(J,-1,nnz,-1,onnz); CHKERRQ(ierr);
+    ierr = PetscFree2(nnz,onnz); CHKERRQ(ierr);
 
     // set nonzeros: put values (=zeros) in allocated locations
-    for (n = 0; n < user->mesh->N; n++) {
+    for (n = 0; n < mesh->Nown; n++) {
         if (abf[n] == 2) {
-            ierr = MatSetValues(J,1,&n,1,&n,&zero,INSERT_VALUES); CHKERRQ(ierr);
+            ierr = MatSetValuesLocal(J,1,&n,1,&n,&zero,INSERT_VALUES); CHKERRQ(ierr);
         }
     }
-    for (k = 0; k < user->mesh->K; k++) {
-        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        // a 3x3 element stiffness matrix (at most) for each element
-        cr = 0;  // cr = count rows
-        for (l = 0; l < 3; l++) {
-            if (abf[en[l]] != 2) {
-                row[cr++] = en[l];
-            }
-        }
-        ierr = MatSetValues(J,cr,row,cr,row,v,INSERT_VALUES); CHKERRQ(ierr);
+    // each non-Dirichlet row:  the node and its non-Dirichlet neighbors
+    ierr = PetscMalloc1(maxrow,&col); CHKERRQ(ierr);
+    ierr = PetscCalloc1(maxrow,&v); CHKERRQ(ierr);
+    for (n = 0; n < Nloc; n++) {
+        if (abf[n] == 2)
+            continue;
+        cc = 0;  // cc = count columns
+        col[cc++] = n;
+        for (j = mesh->nbrptr[n]; j < mesh->nbrptr[n+1]; j++)
+            if (abf[mesh->nbrs[j]] != 2)
+                col[cc++] = mesh->nbrs[j];
+        ierr = MatSetValuesLocal(J,1,&n,cc,col,v,INSERT_VALUES); CHKERRQ(ierr);
     }
+    ierr = PetscFree(col); CHKERRQ(ierr);
+    ierr = PetscFree(v); CHKERRQ(ierr);
     ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
     ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
     // the assembly routine FormPicard() will generate an error if
     //   it tries to put a matrix entry in the wrong place
     ierr = MatSetOption(J,MAT_NEW_NONZERO_LOCATION_ERR,PETSC_TRUE); CHKERRQ(ierr);
-    ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = ISRestoreIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
     return 0;
 }
 //ENDPREALLOC
 
+/* On one process with a SeqAIJ matrix the sparsity pattern can be built
+directly in compressed sparse row form from the node-to-node adjacency of
+UMBuildAdjacency():  row n holds n and the non-Dirichlet nodes which share an
+element with non-Dirichlet node n, and a Dirichlet row holds only its
+diagonal.  This is the same pattern as
+PreallocateAndSetNonzeros() generates.  The CSR arrays go to
+MatSeqAIJSetPreallocationCSR(), which also assembles the zero matrix.
+
+The table user->eoff then gives, for each element and each of its 3x3 entries
+(row-major in local element node order), the offset into the SeqAIJ value
+array, or -1 if the row or column is Dirichlet.  FormPicard() uses it to add
+element matrices straight into the value array. */
+PetscErrorCode PreallocateCSR(Mat J, unfemCtx *user) {
+    PetscErrorCode ierr;
+    UM              *mesh = user->mesh;
+    const PetscInt  *ae, *abf, *en;
+    PetscInt        *ia, *ja, n, k, l, m, j, pos;
+    PetscBool       diag;
+
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    // rows from the sorted node-to-node adjacency, with n inserted in order
+    if (!mesh->nbrptr) {
+        ierr = UMBuildAdjacency(mesh); CHKERRQ(ierr);
+    }
+    ierr = PetscMalloc1(mesh->N+1,&ia); CHKERRQ(ierr);
+    ierr = PetscMalloc1(mesh->N + mesh->nbrptr[mesh->N],&ja); CHKERRQ(ierr);
+    pos = 0;
+    for (n = 0; n < mesh->N; n++) {
+        ia[n] = pos;
+        if (abf[n] == 2) {
+            ja[pos++] = n;
+            continue;
+        }
+        diag = PETSC_FALSE;
+        for (j = mesh->nbrptr[n]; j < mesh->nbrptr[n+1]; j++) {
+            m = mesh->nbrs[j];
+            if ((m > n) && !diag) {
+                ja[pos++] = n;
+                diag = PETSC_TRUE;
+            }
+            if (abf[m] != 2)
+                ja[pos++] = m;
+        }
+        if (!diag)
+            ja[pos++] = n;
+    }
+    ia[mesh->N] = pos;
+    ierr = MatSeqAIJSetPreallocationCSR(J,ia,ja,NULL); CHKERRQ(ierr);
+    ierr = MatSetOption(J,MAT_NEW_NONZERO_LOCATION_ERR,PETSC_TRUE); CHKERRQ(ierr);
+
+    // offsets of element matrix entries in the value array
+    ierr = PetscMalloc1(9*mesh->K,&(user->eoff)); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++) {
+            for (m = 0; m < 3; m++) {
+                if ((abf[en[l]] == 2) || (abf[en[m]] == 2)) {
+                    user->eoff[9*k+3*l+m] = -1;
+                } else {
+                    ierr = PetscFindInt(en[m],ia[en[l]+1]-ia[en[l]],
+                                        ja + ia[en[l]],&j); CHKERRQ(ierr);
+                    user->eoff[9*k+3*l+m] = ia[en[l]] + j;
+                }
+            }
+        }
+    }
+    ierr = PetscFree(ia); CHKERRQ(ierr);
+    ierr = PetscFree(ja); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    return 0;
+}
+
+
+/* P2 elements (-un_order 2).  The P2 nodes of element k are its three
+vertices and then the midpoints of the edges en[0]en[1], en[1]en[2],
+en[2]en[0].  On the reference triangle, with barycentric coordinates
+lambda_l = chi(l,xi,eta), the vertex basis functions are
+lambda_l (2 lambda_l - 1) and the midpoint functions are 4 lambda_a lambda_b.
+The mesh nodes keep their numbers and the midpoint of edge j is P2 node N+j.
+One process only. */
+
+// tabulate the P2 basis and its reference gradient at quadrature points
+static void TabulateP2(unfemCtx *user) {
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    PetscInt         l, a, b, r, d;
+    PetscReal        lam[3];
+    for (r = 0; r < q.n; r++) {
+        for (l = 0; l < 3; l++)
+            lam[l] = chi(l,q.xi[r],q.eta[r]);
+        for (l = 0; l < 3; l++) {
+            a = l;  b = (l+1) % 3;
+            user->psi2[l][r] = lam[l] * (2.0 * lam[l] - 1.0);
+            user->psi2[3+l][r] = 4.0 * lam[a] * lam[b];
+            for (d = 0; d < 2; d++) {
+                user->dpsi2[l][r][d] = (4.0 * lam[l] - 1.0) * dchi[l][d];
+                user->dpsi2[3+l][r][d] = 4.0 * (lam[a] * dchi[b][d]
+                                                + lam[b] * dchi[a][d]);
+            }
+        }
+    }
+}
+
+// build P2 nodes, their flags and the P2 element list from the mesh edges
+PetscErrorCode SetUpP2(unfemCtx *user) {
+    PetscErrorCode ierr;
+    UM             *mesh = user->mesh;
+    const PetscInt *ae, *abf;
+    const Node     *aloc;
+    PetscInt       n, j, k, l, a, b;
+
+    if (!mesh->ee) {
+        ierr = UMSetUpEdges(mesh); CHKERRQ(ierr);
+    }
+    user->N2 = mesh->N + mesh->NE;
+    ierr = PetscMalloc3(6*mesh->K,&(user->e2),user->N2,&(user->bf2),
+                        user->N2,&(user->loc2)); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    for (n = 0; n < mesh->N; n++) {
+        user->loc2[n] = aloc[n];
+        user->bf2[n] = abf[n];
+    }
+    for (j = 0; j < mesh->NE; j++) {
+        a = mesh->edges[2*j+0];  b = mesh->edges[2*j+1];
+        user->loc2[mesh->N+j].x = 0.5 * (aloc[a].x + aloc[b].x);
+        user->loc2[mesh->N+j].y = 0.5 * (aloc[a].y + aloc[b].y);
+        user->bf2[mesh->N+j] = mesh->ebf[j];
+    }
+    for (k = 0; k < mesh->K; k++) {
+        for (l = 0; l < 3; l++) {
+            user->e2[6*k+l] = ae[3*k+l];
+            user->e2[6*k+3+l] = mesh->N + mesh->ee[3*k+l];
+        }
+    }
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    return 0;
+}
+
+// values of u at the P2 nodes of element k
+static void NodalValuesP2(unfemCtx *user, const PetscReal *au, PetscInt k,
+                          PetscReal unode[6]) {
+    const PetscInt *en2 = user->e2 + 6*k;
+    PetscInt       l;
+    for (l = 0; l < 6; l++) {
+        if (user->bf2[en2[l]] == 2)  // enforces symmetry
+            unode[l] = user->gD_fcn(user->loc2[en2[l]].x,user->loc2[en2[l]].y);
+        else
+            unode[l] = au[en2[l]];
+    }
+}
+
+// at quadrature point r:  the value uq and gradient gradu of u, and the
+//   gradients gradpsi of the P2 basis on the element
+static void QuadPointP2(unfemCtx *user, PetscInt r, PetscReal dx1,
+                        PetscReal dx2, PetscReal dy1, PetscReal dy2,
+                        PetscReal detJ, const PetscReal unode[6],
+                        PetscReal *uq, PetscReal gradu[2],
+                        PetscReal gradpsi[6][2]) {
+    PetscInt  l;
+    *uq = 0.0;
+    gradu[0] = 0.0;
+    gradu[1] = 0.0;
+    for (l = 0; l < 6; l++) {
+        gradpsi[l][0] = ( dy2 * user->dpsi2[l][r][0] - dy1 * user->dpsi2[l][r][1]) / detJ;
+        gradpsi[l][1] = (-dx2 * user->dpsi2[l][r][0] + dx1 * user->dpsi2[l][r][1]) / detJ;
+        *uq += unode[l] * user->psi2[l][r];
+        gradu[0] += unode[l] * gradpsi[l][0];
+        gradu[1] += unode[l] * gradpsi[l][1];
+    }
+}
+
+PetscErrorCode FormFunctionP2(SNES snes, Vec u, Vec F, void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx         *user = (unfemCtx*)ctx;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const Quad1D     q1 = gausslegendre[2];
+    const PetscInt   *ae, *ans, *en2, *bf2 = user->bf2;
+    const Node       *aloc, *loc2 = user->loc2;
+    const PetscReal  *au;
+    PetscInt         p, k, l, r, n, sn[3];
+    PetscReal        *aF, unode[6], gradu[2], gradpsi[6][2], res[6], x0, y0,
+                     dx1, dx2, dy1, dy2, detJ, gradpsi1[3][2], uq, xx, yy,
+                     aq, fq, s, ls, gs, psis[3];
+
+    PetscLogStagePush(user->resstage);  //STRIP
+    ierr = VecSet(F,0.0); CHKERRQ(ierr);
+    ierr = VecGetArray(F,&aF); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+
+    // Neumann boundary segment contributions (if any); three-point
+    //   Gauss-Legendre on the segment with quadratic basis in arclength s
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        for (p = 0; p < mesh->P; p++) {
+            sn[0] = ans[2*p+0];  sn[1] = mesh->N + mesh->nse[p];  sn[2] = ans[2*p+1];
+            ls = PetscSqrtReal(  PetscSqr(loc2[sn[2]].x - loc2[sn[0]].x)
+                               + PetscSqr(loc2[sn[2]].y - loc2[sn[0]].y));
+            for (r = 0; r < q1.n; r++) {
+                s = 0.5 * (q1.xi[r] + 1.0);
+                xx = (1.0 - s) * loc2[sn[0]].x + s * loc2[sn[2]].x;
+                yy = (1.0 - s) * loc2[sn[0]].y + s * loc2[sn[2]].y;
+                gs = 0.5 * ls * q1.w[r] * user->gN_fcn(xx,yy);
+                psis[0] = (1.0 - s) * (1.0 - 2.0 * s);
+                psis[1] = 4.0 * s * (1.0 - s);
+                psis[2] = s * (2.0 * s - 1.0);
+                for (l = 0; l < 3; l++) {
+                    if (bf2[sn[l]] != 2)
+                        aF[sn[l]] -= gs * psis[l];
+                }
+            }
+        }
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+
+    // element contributions
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        en2 = user->e2 + 6*k;
+        ElementGeometry(mesh,k,ae+3*k,aloc,&x0,&y0,&dx1,&dx2,&dy1,&dy2,
+                        &detJ,gradpsi1);
+        NodalValuesP2(user,au,k,unode);
+        for (l = 0; l < 6; l++)
+            res[l] = 0.0;
+        for (r = 0; r < q.n; r++) {
+            QuadPointP2(user,r,dx1,dx2,dy1,dy2,detJ,unode,&uq,gradu,gradpsi);
+            xx = x0 + dx1 * q.xi[r] + dx2 * q.eta[r];
+            yy = y0 + dy1 * q.xi[r] + dy2 * q.eta[r];
+            aq = user->a_fcn(uq,xx,yy);
+            fq = user->f_fcn(uq,xx,yy);
+            for (l = 0; l < 6; l++)
+                res[l] += q.w[r] * (  aq * InnerProd(gradu,gradpsi[l])
+                                    - fq * user->psi2[l][r]);
+        }
+        for (l = 0; l < 6; l++) {
+            if (bf2[en2[l]] != 2)
+                aF[en2[l]] += PetscAbsReal(detJ) * res[l];
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    // Dirichlet residuals
+    for (n = 0; n < user->N2; n++) {
+        if (bf2[n] == 2)
+            aF[n] = au[n] - user->gD_fcn(loc2[n].x,loc2[n].y);
+    }
+
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = VecRestoreArray(F,&aF); CHKERRQ(ierr);
+    PetscLogStagePop();  //STRIP
+    return 0;
+}
+
+// P2 form of AssembleMatrix(); 6x6 element matrices
+static PetscErrorCode AssembleMatrixP2(Vec u, Mat P, unfemCtx *user,
+                                       PetscBool newton) {
+    PetscErrorCode ierr;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const PetscInt   *ae, *en2, *bf2 = user->bf2;
+    const Node       *aloc;
+    const PetscReal  *au;
+    PetscInt         n, k, l, m, r, cr, cv, row[6];
+    PetscReal        unode[6], gradu[2], gradpsi[6][2], ke[6][6], v[36],
+                     x0, y0, dx1, dx2, dy1, dy2, detJ, gradpsi1[3][2], uq,
+                     xx, yy, aq, daq = 0.0, dfq = 0.0, one = 1.0;
+
+    ierr = MatZeroEntries(P); CHKERRQ(ierr);
+    for (n = 0; n < user->N2; n++) {
+        if (bf2[n] == 2) {
+            ierr = MatSetValues(P,1,&n,1,&n,&one,ADD_VALUES); CHKERRQ(ierr);
+        }
+    }
+    ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        en2 = user->e2 + 6*k;
+        ElementGeometry(mesh,k,ae+3*k,aloc,&x0,&y0,&dx1,&dx2,&dy1,&dy2,
+                        &detJ,gradpsi1);
+        NodalValuesP2(user,au,k,unode);
+        for (l = 0; l < 6; l++)
+            for (m = 0; m < 6; m++)
+                ke[l][m] = 0.0;
+        for (r = 0; r < q.n; r++) {
+            QuadPointP2(user,r,dx1,dx2,dy1,dy2,detJ,unode,&uq,gradu,gradpsi);
+            xx = x0 + dx1 * q.xi[r] + dx2 * q.eta[r];
+            yy = y0 + dy1 * q.xi[r] + dy2 * q.eta[r];
+            aq = user->a_fcn(uq,xx,yy);
+            if (newton) {
+                daq = user->da_fcn(uq,xx,yy);
+                dfq = user->df_fcn(uq,xx,yy);
+            }
+            for (l = 0; l < 6; l++) {
+                for (m = 0; m < 6; m++) {
+                    ke[l][m] += q.w[r] * aq * InnerProd(gradpsi[l],gradpsi[m]);
+                    if (newton)
+                        ke[l][m] += q.w[r] * user->psi2[m][r]
+                                    * (  daq * InnerProd(gradu,gradpsi[l])
+                                       - dfq * user->psi2[l][r]);
+                }
+            }
+        }
+        // omit Dirichlet rows and columns
+        cr = 0;  cv = 0;
+        for (l = 0; l < 6; l++) {
+            if (bf2[en2[l]] != 2) {
+                row[cr++] = en2[l];
+                for (m = 0; m < 6; m++) {
+                    if (bf2[en2[m]] != 2)
+                        v[cv++] = PetscAbsReal(detJ) * ke[l][m];
+                }
+            }
+        }
+        ierr = MatSetValues(P,cr,row,cr,row,v,ADD_VALUES); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = MatAssemblyBegin(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    return 0;
+}
+
+// exact sparsity of the P2 matrix, in the manner of PreallocateCSR()
+PetscErrorCode PreallocateP2(Mat J, unfemCtx *user) {
+    PetscErrorCode ierr;
+    const PetscInt  *en2, *bf2 = user->bf2;
+    PetscInt        *ia, *ja, *cnt, n, k, l, m, j, nrow, pos;
+
+    ierr = PetscMalloc2(user->N2+1,&ia,user->N2,&cnt); CHKERRQ(ierr);
+    for (n = 0; n < user->N2; n++)
+        cnt[n] = 1;  // diagonal
+    for (k = 0; k < user->mesh->K; k++) {
+        en2 = user->e2 + 6*k;
+        for (l = 0; l < 6; l++)
+            if (bf2[en2[l]] != 2)
+                cnt[en2[l]] += 5;
+    }
+    ia[0] = 0;
+    for (n = 0; n < user->N2; n++)
+        ia[n+1] = ia[n] + cnt[n];
+    ierr = PetscMalloc1(ia[user->N2],&ja); CHKERRQ(ierr);
+    for (n = 0; n < user->N2; n++) {
+        ja[ia[n]] = n;
+        cnt[n] = 1;
+    }
+    for (k = 0; k < user->mesh->K; k++) {
+        en2 = user->e2 + 6*k;
+        for (l = 0; l < 6; l++) {
+            if (bf2[en2[l]] == 2)
+                continue;
+            for (m = 0; m < 6; m++) {
+                if ((m != l) && (bf2[en2[m]] != 2))
+                    ja[ia[en2[l]] + cnt[en2[l]]++] = en2[m];
+            }
+        }
+    }
+    pos = 0;
+    for (n = 0; n < user->N2; n++) {
+        nrow = cnt[n];
+        ierr = PetscSortRemoveDupsInt(&nrow,ja + ia[n]); CHKERRQ(ierr);
+        for (j = 0; j < nrow; j++)
+            ja[pos + j] = ja[ia[n] + j];
+        ia[n] = pos;
+        pos += nrow;
+    }
+    ia[user->N2] = pos;
+    ierr = MatSeqAIJSetPreallocationCSR(J,ia,ja,NULL); CHKERRQ(ierr);
+    ierr = PetscFree2(ia,cnt); CHKERRQ(ierr);
+    ierr = PetscFree(ja); CHKERRQ(ierr);
+    return 0;
+}
+
+/* Adaptive refinement (-un_adapt).  One process and P1 only. */
+
+// solve on the current mesh, from initial iterate u, with the default
+//   solver for the Jacobian type as modified by options with prefix
+//   un_adapt_, e.g. -un_adapt_snes_monitor, so that the options for the
+//   final solve do not apply to these intermediate solves
+PetscErrorCode AdaptSolve(unfemCtx *user, JacobianType jactype, Vec u) {
+    PetscErrorCode ierr;
+    UM       *mesh = user->mesh;
+    SNES     snes;
+    KSP      ksp;
+    PC       pc;
+    Mat      A;
+    Vec      r;
+
+    ierr = VecDuplicate(u,&r); CHKERRQ(ierr);
+    ierr = SNESCreate(PETSC_COMM_WORLD,&snes); CHKERRQ(ierr);
+    ierr = SNESSetOptionsPrefix(snes,"un_adapt_"); CHKERRQ(ierr);
+    ierr = SNESSetFunction(snes,r,FormFunction,user); CHKERRQ(ierr);
+    ierr = SNESGetKSP(snes,&ksp); CHKERRQ(ierr);
+    ierr = KSPGetPC(ksp,&pc); CHKERRQ(ierr);
+    if (jactype == PICARD) {
+        ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
+        ierr = PCSetType(pc,PCICC); CHKERRQ(ierr);
+    } else {
+        ierr = KSPSetType(ksp,KSPGMRES); CHKERRQ(ierr);
+        ierr = PCSetType(pc,PCILU); CHKERRQ(ierr);
+    }
+    ierr = MatCreate(PETSC_COMM_WORLD,&A); CHKERRQ(ierr);
+    ierr = MatSetSizes(A,mesh->Nown,mesh->Nown,mesh->N,mesh->N); CHKERRQ(ierr);
+    ierr = MatSetOptionsPrefix(A,"un_adapt_"); CHKERRQ(ierr);
+    ierr = MatSetFromOptions(A); CHKERRQ(ierr);
+    ierr = MatSetOption(A,MAT_SYMMETRIC,
+                        (jactype == PICARD) ? PETSC_TRUE : PETSC_FALSE); CHKERRQ(ierr);
+    ierr = MatSetLocalToGlobalMapping(A,mesh->ltog,mesh->ltog); CHKERRQ(ierr);
+    ierr = PreallocateAndSetNonzeros(A,user); CHKERRQ(ierr);
+    ierr = SNESSetJacobian(snes,A,A,
+                           (jactype == PICARD) ? FormPicard : FormJacobian,
+                           user); CHKERRQ(ierr);
+    ierr = SNESSetFromOptions(snes); CHKERRQ(ierr);
+    ierr = SNESSolve(snes,NULL,u); CHKERRQ(ierr);
+    MatDestroy(&A);  SNESDestroy(&snes);  VecDestroy(&r);
+    return 0;
+}
+
+/* Residual-based indicators for P1, with the same a, f, gN as FormFunction():
+   eta2[k] = h_K^2 ||f + (da/du) |grad u|^2||_K^2
+             + sum_E w_E h_E ||J_E||_E^2,
+where h_K is the longest side, the first term is the strong residual
+-div(a(u) grad u) - f with grad u constant on K, and J_E is the jump in the
+flux a(u) grad u . n across an interior edge (w_E = 1/2), or gN minus the
+flux on a non-Dirichlet boundary edge (w_E = 1).  J_E is evaluated at the
+edge midpoint, so ||J_E||_E^2 = h_E J_E^2.  The total is the sum of eta2. */
+PetscErrorCode ErrorIndicators(unfemCtx *user, Vec u, PetscReal *eta2,
+                               PetscReal *total) {
+    PetscErrorCode ierr;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const PetscInt   *ae, *abf, *en;
+    const Node       *aloc;
+    const PetscReal  *au;
+    PetscInt         k, l, r, p, j, a, b, c;
+    PetscReal        *flux, *gbdry, unode[3], gradu[2], gradpsi[3][2], x0, y0,
+                     dx1, dx2, dy1, dy2, detJ, uq, xx, yy, res, sum, hK,
+                     hE, nx, ny, xm, ym, um, J;
+
+    if (!mesh->ee) {
+        ierr = UMSetUpEdges(mesh); CHKERRQ(ierr);
+    }
+    ierr = PetscCalloc2(mesh->NE,&flux,mesh->NE,&gbdry); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    // Neumann data on segment edges; other boundary edges have gN = 0
+    for (p = 0; p < mesh->P; p++) {
+        j = mesh->nse[p];
+        a = mesh->edges[2*j+0];  b = mesh->edges[2*j+1];
+        gbdry[j] = user->gN_fcn(0.5 * (aloc[a].x + aloc[b].x),
+                                0.5 * (aloc[a].y + aloc[b].y));
+    }
+    // interior residual, and outward fluxes summed on each edge
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + 3*k;
+        ElementGeometry(mesh,k,en,aloc,&x0,&y0,&dx1,&dx2,&dy1,&dy2,
+                        &detJ,gradpsi);
+        gradu[0] = 0.0;
+        gradu[1] = 0.0;
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] == 2)
+                unode[l] = DirichletValue(user,aloc,en[l]);
+            else
+                unode[l] = au[en[l]];
+            gradu[0] += unode[l] * gradpsi[l][0];
+            gradu[1] += unode[l] * gradpsi[l][1];
+        }
+        sum = 0.0;
+        for (r = 0; r < q.n; r++) {
+            uq = evalq(user,unode,r);
+            xx = x0 + dx1 * q.xi[r] + dx2 * q.eta[r];
+            yy = y0 + dy1 * q.xi[r] + dy2 * q.eta[r];
+            res = user->f_fcn(uq,xx,yy)
+                  + user->da_fcn(uq,xx,yy) * InnerProd(gradu,gradu);
+            sum += q.w[r] * res * res;
+        }
+        hK = 0.0;
+        for (l = 0; l < 3; l++) {
+            a = en[l];  b = en[(l+1)%3];  c = en[(l+2)%3];
+            hE = PetscSqrtReal(  PetscSqr(aloc[b].x - aloc[a].x)
+                               + PetscSqr(aloc[b].y - aloc[a].y));
+            hK = PetscMax(hK,hE);
+            // unit normal to edge ab, pointing away from c
+            nx = (aloc[b].y - aloc[a].y) / hE;
+            ny = - (aloc[b].x - aloc[a].x) / hE;
+            xm = 0.5 * (aloc[a].x + aloc[b].x);
+            ym = 0.5 * (aloc[a].y + aloc[b].y);
+            if (nx * (aloc[c].x - xm) + ny * (aloc[c].y - ym) > 0.0) {
+                nx = -nx;  ny = -ny;
+            }
+            um = 0.5 * (unode[l] + unode[(l+1)%3]);
+            flux[mesh->ee[3*k+l]] += user->a_fcn(um,xm,ym)
+                                     * (gradu[0] * nx + gradu[1] * ny);
+        }
+        eta2[k] = hK * hK * PetscAbsReal(detJ) * sum;
+    }
+    // edge terms
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++) {
+            j = mesh->ee[3*k+l];
+            if (mesh->ebf[j] == 2)
+                continue;
+            a = en[l];  b = en[(l+1)%3];
+            hE = PetscSqrtReal(  PetscSqr(aloc[b].x - aloc[a].x)
+                               + PetscSqr(aloc[b].y - aloc[a].y));
+            if (mesh->ebf[j] == 0) {
+                J = flux[j];
+                eta2[k] += 0.5 * hE * hE * J * J;
+            } else {
+                J = gbdry[j] - flux[j];
+                eta2[k] += hE * hE * J * J;
+            }
+        }
+    }
+    *total = 0.0;
+    for (k = 0; k < mesh->K; k++)
+        *total += eta2[k];
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
+    ierr = PetscFree2(flux,gbdry); CHKERRQ(ierr);
+    return 0;
+}
+
+// Dorfler (bulk) marking:  mark the fewest elements, largest indicators
+//   first, whose indicators sum to at least theta times the total
+PetscErrorCode DorflerMark(PetscInt K, const PetscReal *eta2, PetscReal theta,
+                           PetscBool *marked, PetscInt *nmarked) {
+    PetscErrorCode ierr;
+    PetscInt   *perm, k;
+    PetscReal  total = 0.0, sum = 0.0;
+
+    ierr = PetscMalloc1(K,&perm); CHKERRQ(ierr);
+    for (k = 0; k < K; k++) {
+        perm[k] = k;
+        marked[k] = PETSC_FALSE;
+        total += eta2[k];
+    }
+    ierr = PetscSortRealWithPermutation(K,eta2,perm); CHKERRQ(ierr);  // increasing
+    *nmarked = 0;
+    for (k = K-1; (k >= 0) && (sum < theta * total); k--) {
+        marked[perm[k]] = PETSC_TRUE;
+        sum += eta2[perm[k]];
+        (*nmarked)++;
+    }
+    ierr = PetscFree(perm); CHKERRQ(ierr);
+    return 0;
+}
+
+// replace *u on coarse by its P1 interpolant on fine, from UMBisect()
+PetscErrorCode InterpolateBisected(UM *coarse, UM *fine,
+                                   const PetscInt *parents, Vec *u) {
+    PetscErrorCode ierr;
+    const PetscReal  *auc;
+    PetscReal        *auf;
+    PetscInt         i;
+    Vec              uf;
+
+    ierr = UMCreateGlobalVec(fine,&uf); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(*u,&auc); CHKERRQ(ierr);
+    ierr = VecGetArray(uf,&auf); CHKERRQ(ierr);
+    for (i = 0; i < coarse->N; i++)
+        auf[i] = auc[i];
+    for (i = 0; i < fine->N - coarse->N; i++)
+        auf[coarse->N+i] = 0.5 * (auc[parents[2*i+0]] + auc[parents[2*i+1]]);
+    ierr = VecRestoreArray(uf,&auf); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(*u,&auc); CHKERRQ(ierr);
+    ierr = VecDestroy(u); CHKERRQ(ierr);
+    *u = uf;
+    return 0;
+}
+
+
+/* A GAMG hierarchy with L levels is saved as the L-1 interpolations, coarsest
+first, in one PETSc binary file.  They follow a header Vec holding N, K, the
+node reordering and a checksum of the elements in global node numbering, so
+that a hierarchy is only loaded for the mesh, and numbering, it was saved
+from.  Loading reads the interpolations until one has as many rows as the
+solution Vec.  On P processes both MatLoad() and the mesh split rows in the
+same way, so the finest interpolation matches the Vec layout. */
+
+#define MAXHIERLEVELS 30
+#define HIERHEADER    5    // length of header:  tag, N, K, reorder, checksum
+#define HIERTAG       1211217.0
+
+// order-independent checksum of the elements, in [0,2^31), the same on all
+//   processes
+static PetscErrorCode HierarchyHeader(UM *mesh, UMReorderType reorder,
+                                      PetscReal *header) {
+    PetscErrorCode ierr;
+    const PetscInt      *ae, *ltogidx;
+    PetscInt            k, l, m, t, g[3];
+    unsigned long long  h, sum = 0, allsum;
+
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingGetIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+    for (k = 0; k < mesh->Kown; k++) {
+        // sort global indices so the orientation of the element does not matter
+        for (l = 0; l < 3; l++)
+            g[l] = ltogidx[ae[3*k+l]];
+        for (l = 0; l < 2; l++)
+            for (m = 0; m < 2 - l; m++)
+                if (g[m] > g[m+1]) {
+                    t = g[m];  g[m] = g[m+1];  g[m+1] = t;
+                }
+        h = (unsigned long long)g[0];
+        for (l = 1; l < 3; l++)
+            h = h * 1000003ULL + (unsigned long long)g[l];
+        h ^= h >> 31;
+        h *= 0x9E3779B97F4A7C15ULL;
+        sum += h ^ (h >> 29);
+    }
+    ierr = ISLocalToGlobalMappingRestoreIndices(mesh->ltog,&ltogidx); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = MPI_Allreduce(&sum,&allsum,1,MPI_UNSIGNED_LONG_LONG,MPI_SUM,
+                         PETSC_COMM_WORLD); CHKERRQ(ierr);
+    header[0] = HIERTAG;
+    header[1] = (PetscReal)mesh->N;
+    header[2] = (PetscReal)mesh->K;
+    header[3] = (PetscReal)reorder;
+    header[4] = (PetscReal)((allsum ^ (allsum >> 31) ^ (allsum >> 62)) & 0x7FFFFFFFULL);
+    return 0;
+}
+
+// header Vec has all entries on rank 0
+static PetscErrorCode HierarchyHeaderVec(Vec *vheader) {
+    PetscErrorCode ierr;
+    PetscMPIInt rank;
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    ierr = VecCreate(PETSC_COMM_WORLD,vheader); CHKERRQ(ierr);
+    ierr = VecSetSizes(*vheader,(rank == 0) ? HIERHEADER : 0,HIERHEADER); CHKERRQ(ierr);
+    ierr = VecSetFromOptions(*vheader); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode SaveHierarchy(PC pc, UM *mesh, UMReorderType reorder,
+                             const char *root) {
+    PetscErrorCode ierr;
+    char        filename[PETSC_MAX_PATH_LEN];
+    PetscInt    levels, j;
+    PetscReal   header[HIERHEADER], *ah;
+    Vec         vheader;
+    Mat         pint;
+    PetscViewer viewer;
+
+    ierr = PCMGGetLevels(pc,&levels); CHKERRQ(ierr);
+    ierr = PetscSNPrintf(filename,sizeof(filename),"%s.pint",root); CHKERRQ(ierr);
+    ierr = PetscPrintf(PETSC_COMM_WORLD,
+               "  saving interpolation operators for %d levels in binary format to %s ...\n",
+               levels,filename); CHKERRQ(ierr);
+    ierr = HierarchyHeader(mesh,reorder,header); CHKERRQ(ierr);
+    ierr = HierarchyHeaderVec(&vheader); CHKERRQ(ierr);
+    ierr = VecGetLocalSize(vheader,&j); CHKERRQ(ierr);
+    ierr = VecGetArray(vheader,&ah); CHKERRQ(ierr);
+    if (j > 0) {
+        ierr = PetscMemcpy(ah,header,HIERHEADER*sizeof(PetscReal)); CHKERRQ(ierr);
+    }
+    ierr = VecRestoreArray(vheader,&ah); CHKERRQ(ierr);
+    ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_WRITE,&viewer); CHKERRQ(ierr);
+    ierr = VecView(vheader,viewer); CHKERRQ(ierr);
+    for (j = 1; j < levels; j++) {
+        ierr = PCMGGetInterpolation(pc,j,&pint); CHKERRQ(ierr);
+        ierr = MatView(pint,viewer); CHKERRQ(ierr);
+    }
+    ierr = PetscViewerDestroy(&viewer); CHKERRQ(ierr);
+    ierr = VecDestroy(&vheader); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode LoadHierarchy(PC pc, UM *mesh, UMReorderType reorder,
+                             const char *root, Vec u) {
+    PetscErrorCode ierr;
+    char        filename[PETSC_MAX_PATH_LEN];
+    PetscInt    N, nrows = 0, ncols, npint = 0, j;
+    PetscReal   header[HIERHEADER], saved[HIERHEADER];
+    const PetscReal *ah;
+    Vec         vheader;
+    Mat         pint[MAXHIERLEVELS];
+    PetscViewer viewer;
+
+    ierr = VecGetSize(u,&N); CHKERRQ(ierr);
+    ierr = PetscSNPrintf(filename,sizeof(filename),"%s.pint",root); CHKERRQ(ierr);
+    ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&viewer); CHKERRQ(ierr);
+    // compare header with this mesh before reading any interpolation
+    ierr = HierarchyHeader(mesh,reorder,header); CHKERRQ(ierr);
+    ierr = HierarchyHeaderVec(&vheader); CHKERRQ(ierr);
+    ierr = VecLoad(vheader,viewer); CHKERRQ(ierr);
+    ierr = VecGetLocalSize(vheader,&j); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(vheader,&ah); CHKERRQ(ierr);
+    if (j > 0) {
+        ierr = PetscMemcpy(saved,ah,HIERHEADER*sizeof(PetscReal)); CHKERRQ(ierr);
+    }
+    ierr = VecRestoreArrayRead(vheader,&ah); CHKERRQ(ierr);
+    ierr = VecDestroy(&vheader); CHKERRQ(ierr);
+    ierr = MPI_Bcast(saved,HIERHEADER,MPIU_REAL,0,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    if ((saved[0] != HIERTAG) || (saved[3] < 0.0) || (saved[3] > REORDER_HILBERT)) {
+        SETERRQ1(PETSC_COMM_SELF,4,"%s is not a hierarchy file from -un_gamg_save_hierarchy",
+                 filename);
+    }
+    if ((saved[1] != header[1]) || (saved[2] != header[2])) {
+        SETERRQ4(PETSC_COMM_SELF,5,"hierarchy was saved for N=%d, K=%d but mesh has N=%d, K=%d",
+                 (PetscInt)saved[1],(PetscInt)saved[2],mesh->N,mesh->K);
+    }
+    if (saved[3] != header[3]) {
+        SETERRQ2(PETSC_COMM_SELF,6,"hierarchy was saved with -un_reorder %s but this run uses -un_reorder %s",
+                 UMReorderTypes[(PetscInt)saved[3]],UMReorderTypes[reorder]);
+    }
+    if (saved[4] != header[4]) {
+        SETERRQ(PETSC_COMM_SELF,7,"hierarchy was saved for a mesh with different elements");
+    }
+    while (nrows < N) {
+        if (npint == MAXHIERLEVELS) {
+            SETERRQ1(PETSC_COMM_SELF,1,"more than %d levels in hierarchy file",
+                     MAXHIERLEVELS+1);
+        }
+        ierr = MatCreate(PETSC_COMM_WORLD,&(pint[npint])); CHKERRQ(ierr);
+        ierr = MatLoad(pint[npint],viewer); CHKERRQ(ierr);
+        ierr = MatGetSize(pint[npint],&j,&ncols); CHKERRQ(ierr);
+        if ((npint > 0) && (ncols != nrows)) {
+            SETERRQ2(PETSC_COMM_SELF,2,"interpolation has %d columns but coarser level has %d rows",
+                     ncols,nrows);
+        }
+        nrows = j;
+        npint++;
+    }
+    ierr = PetscViewerDestroy(&viewer); CHKERRQ(ierr);
+    if (nrows != N) {
+        SETERRQ2(PETSC_COMM_SELF,3,"finest interpolation has %d rows but problem has N=%d; saved for another mesh?",
+                 nrows,N);
+    }
+    ierr = PetscPrintf(PETSC_COMM_WORLD,
+               "  loaded interpolation operators for %d levels from %s\n",
+               npint+1,filename); CHKERRQ(ierr);
+    ierr = PCSetType(pc,PCMG); CHKERRQ(ierr);
+    ierr = PCMGSetLevels(pc,npint+1,NULL); CHKERRQ(ierr);
+    for (j = 1; j <= npint; j++) {
+        ierr = PCMGSetInterpolation(pc,j,pint[j-1]); CHKERRQ(ierr);
+        ierr = MatDestroy(&(pint[j-1])); CHKERRQ(ierr);
+    }
+    ierr = PCMGSetGalerkin(pc,PC_MG_GALERKIN_BOTH); CHKERRQ(ierr);
+    return 0;
+}
@@ -112,6 +112,10 @@ int main(int argc,char **argv) {
   user.cx = 1.0;
   user.cy = 1.0;
   user.cz = 1.0;
+  user.cache_gbdry = PETSC_FALSE;
+  user.tile_i = 0;
+  user.tile_j = 0;
+  user.n_term = NULL;
   user.g_bdry = &g_fcn;
   user.f_rhs = &f_fcn;
   user.addctx = &dctx;
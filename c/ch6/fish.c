@@ -5,7 +5,13 @@ static char help[] =
 "subject to Dirichlet boundary conditions.  Solves three different problems\n"
 "where exact solution is known.  Uses DMDA and SNES.  Equation is put in form\n"
 "F(u) = - grad^2 u - f.  Call-backs fully-rediscretize for the supplied grid.\n"
-"Defaults to 2D, a SNESType of KSPONLY, and a KSPType of CG.\n\n";
+"Defaults to 2D, a SNESType of KSPONLY, and a KSPType of CG.  Option\n"
+"-fsh_lambda L adds a reaction term L e^u to the equation, with f changed so\n"
+"the exact solution is the same, and then the default SNESType is NEWTONLS.\n"
+"Option -fsh_matfree uses stencil MATSHELL operators on all grids, with PCSOR\n"
+"as the default; with -pc_type mg also use e.g. -mg_coarse_pc_type sor.\n"
+"Red-black nonlinear Gauss-Seidel is available through -snes_type ngs or, as a\n"
+"smoother, -snes_type fas -fas_levels_snes_type ngs -fas_coarse_snes_type ngs.\n\n";
 
 #include <petsc.h>
 #include "poissonfunctions.h"
@@ -81,6 +87,29 @@ static PetscReal f_rhs_3Dmanuexp(PetscReal x, PetscReal y, PetscReal z, void *ct
     return 2.0 * x * PetscExpReal(y + z);  // note  f = - laplacian u = - 2 u
 }
 
+// optional reaction term  n(u) = lambda e^u,  for lambda >= 0; the right side
+// becomes  f + n(u_exact)  so that u_exact is unchanged; u_exact = g_bdry
+typedef struct {
+    PetscReal lambda;
+    PetscReal (*f_linear)(PetscReal x, PetscReal y, PetscReal z, void *ctx);
+} ReactionCtx;
+
+static PetscReal n_term_reaction(PetscReal u, PetscReal x, PetscReal y, PetscReal z,
+                                 PetscReal *dndu, void *ctx) {
+    PoissonCtx*  user = (PoissonCtx*)ctx;
+    ReactionCtx* rctx = (ReactionCtx*)(user->addctx);
+    *dndu = rctx->lambda * PetscExpReal(u);
+    return *dndu;
+}
+
+static PetscReal f_rhs_reaction(PetscReal x, PetscReal y, PetscReal z, void *ctx) {
+    PoissonCtx*  user = (PoissonCtx*)ctx;
+    ReactionCtx* rctx = (ReactionCtx*)(user->addctx);
+    PetscReal    dndu;
+    return rctx->f_linear(x,y,z,ctx)
+           + n_term_reaction(user->g_bdry(x,y,z,ctx),x,y,z,&dndu,ctx);
+}
+
 // functions simply to put u_exact()=g_bdry() into a grid
 // these are irritatingly-dimension-dependent inside ...
 extern PetscErrorCode Form1DUExact(DMDALocalInfo*, Vec, PoissonCtx*);
@@ -99,6 +128,9 @@ static DMDASNESJacobian jacobian_ptr[3]
        (DMDASNESJacobian)&Poisson2DJacobianLocal,
        (DMDASNESJacobian)&Poisson3DJacobianLocal};
 
+static PetscErrorCode (*ngs_ptr[3])(SNES,Vec,Vec,void*)
+    = {&Poisson1DNGSLocal, &Poisson2DNGSLocal, &Poisson3DNGSLocal};
+
 typedef PetscErrorCode (*ExactFcnVec)(DMDALocalInfo*,Vec,PoissonCtx*);
 
 static ExactFcnVec getuexact_ptr[3]
@@ -130,8 +162,10 @@ int main(int argc,char **argv) {
     DM             da, da_after;
     SNES           snes;
     KSP            ksp;
+    PC             pc;
     Vec            u_initial, u, u_exact;
     PoissonCtx     user;
+    ReactionCtx    rctx;
     DMDALocalInfo  info;
     PetscReal      errinf, normconst2h, err2h;
     char           gridstr[99];
@@ -142,6 +176,9 @@ int main(int argc,char **argv) {
     ProblemType    problem = MANUEXP;        // manufactured problem using exp()
     InitialType    initial = ZEROS;          // set u=0 for initial iterate
     PetscBool      gonboundary = PETSC_TRUE; // initial iterate has u=g on boundary
+    PetscBool      matfree = PETSC_FALSE;    // assembled (AIJ) Jacobians
+    PetscBool      bandwidth = PETSC_FALSE;  // no 3D residual traffic report
+    PetscBool      bwtiming = PETSC_TRUE;    // ... but if so, include timing
 
     ierr = PetscInitialize(&argc,&argv,NULL,help); if (ierr) return ierr;
 
@@ -152,7 +189,15 @@ int main(int argc,char **argv) {
     user.cx = 1.0;
     user.cy = 1.0;
     user.cz = 1.0;
+    user.cache_gbdry = PETSC_FALSE;
+    user.tile_i = 0;
+    user.tile_j = 0;
+    user.n_term = NULL;
+    rctx.lambda = 0.0;
     ierr = PetscOptionsBegin(PETSC_COMM_WORLD,"fsh_", "options for fish.c", ""); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-cache_gbdry",
+         "evaluate Dirichlet boundary values once per grid and reuse them",
+         "fish.c",user.cache_gbdry,&user.cache_gbdry,NULL);CHKERRQ(ierr);
     ierr = PetscOptionsReal("-cx",
          "set coefficient of x term u_xx in equation",
          "fish.c",user.cx,&user.cx,NULL);CHKERRQ(ierr);
@@ -162,6 +207,12 @@ int main(int argc,char **argv) {
     ierr = PetscOptionsReal("-cz",
          "set coefficient of z term u_zz in equation",
          "fish.c",user.cz,&user.cz,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-bandwidth",
+         "report modeled memory traffic and effective bandwidth of 3D residuals",
+         "fish.c",bandwidth,&bandwidth,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-bandwidth_timing",
+         "with -fsh_bandwidth, also report time and effective bandwidth (false gives reproducible output)",
+         "fish.c",bwtiming,&bwtiming,NULL);CHKERRQ(ierr);
     ierr = PetscOptionsInt("-dim",
          "dimension of problem (=1,2,3 only)",
          "fish.c",dim,&dim,NULL);CHKERRQ(ierr);
@@ -171,6 +222,12 @@ int main(int argc,char **argv) {
     ierr = PetscOptionsEnum("-initial_type",
          "type of initial iterate",
          "fish.c",InitialTypes,(PetscEnum)initial,(PetscEnum*)&initial,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-matfree",
+         "use matrix-free stencil operators (MATSHELL) in place of assembled Jacobians",
+         "fish.c",matfree,&matfree,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsReal("-lambda",
+         "coefficient of reaction term lambda e^u in equation (>= 0)",
+         "fish.c",rctx.lambda,&rctx.lambda,NULL);CHKERRQ(ierr);
     ierr = PetscOptionsReal("-Lx",
          "set Lx in domain ([0,Lx] x [0,Ly] x [0,Lz], etc.)",
          "fish.c",user.Lx,&user.Lx,NULL);CHKERRQ(ierr);
@@ -183,6 +240,12 @@ int main(int argc,char **argv) {
     ierr = PetscOptionsEnum("-problem",
          "problem type; determines exact solution and RHS",
          "fish.c",ProblemTypes,(PetscEnum)problem,(PetscEnum*)&problem,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-tile_i",
+         "tile size in x direction for 3D residual (0 = automatic)",
+         "fish.c",user.tile_i,&user.tile_i,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-tile_j",
+         "tile size in y direction for 3D residual (0 = automatic)",
+         "fish.c",user.tile_j,&user.tile_j,NULL);CHKERRQ(ierr);
     ierr = PetscOptionsEnd(); CHKERRQ(ierr);
     user.g_bdry = g_bdry_ptr[dim-1][problem];
     user.f_rhs = f_rhs_ptr[dim-1][problem];
@@ -192,6 +255,18 @@ int main(int argc,char **argv) {
     if ((problem == MANUEXP) && ( user.cx != 1.0 || user.cy != 1.0 || user.cz != 1.0)) {
         SETERRQ(PETSC_COMM_SELF,3,"cx=cy=cz=1 required for problem MANUEXP\n");
     }
+    if (rctx.lambda < 0.0) {
+        SETERRQ(PETSC_COMM_SELF,5,"lambda >= 0 required for reaction term\n");
+    }
+    if (matfree && rctx.lambda > 0.0) {
+        SETERRQ(PETSC_COMM_SELF,6,"-fsh_matfree requires lambda = 0 (MATSHELL Jacobian is linear)\n");
+    }
+    if (rctx.lambda > 0.0) {
+        rctx.f_linear = user.f_rhs;
+        user.f_rhs = &f_rhs_reaction;
+        user.n_term = &n_term_reaction;
+        user.addctx = &rctx;
+    }
 
 //STARTCREATE
     // create DMDA in chosen dimension
@@ -216,6 +291,10 @@ int main(int argc,char **argv) {
             SETERRQ(PETSC_COMM_SELF,1,"invalid dim for DMDA creation\n");
     }
     ierr = DMSetApplicationContext(da,&user); CHKERRQ(ierr);
+    if (matfree) {
+        // inherited by coarsened and refined DMDAs
+        ierr = DMSetMatType(da,MATSHELL); CHKERRQ(ierr);
+    }
     ierr = DMSetFromOptions(da); CHKERRQ(ierr);
     ierr = DMSetUp(da); CHKERRQ(ierr);  // call BEFORE SetUniformCoordinates
     ierr = DMDASetUniformCoordinates(da,0.0,user.Lx,0.0,user.Ly,0.0,user.Lz); CHKERRQ(ierr);
@@ -227,11 +306,18 @@ int main(int argc,char **argv) {
              (DMDASNESFunction)(residual_ptr[dim-1]),&user); CHKERRQ(ierr);
     ierr = DMDASNESSetJacobianLocal(da,
              (DMDASNESJacobian)(jacobian_ptr[dim-1]),&user); CHKERRQ(ierr);
+    ierr = SNESSetNGS(snes,ngs_ptr[dim-1],&user); CHKERRQ(ierr);
 
-    // default to KSPONLY+CG because problem is linear and SPD
-    ierr = SNESSetType(snes,SNESKSPONLY); CHKERRQ(ierr);
+    // default to KSPONLY+CG because problem is linear and SPD; with the
+    // reaction term it is nonlinear but the Jacobian is still SPD
+    ierr = SNESSetType(snes,(user.n_term) ? SNESNEWTONLS : SNESKSPONLY); CHKERRQ(ierr);
     ierr = SNESGetKSP(snes,&ksp); CHKERRQ(ierr);
     ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
+    if (matfree) {
+        // default ILU/ICC needs an assembled matrix
+        ierr = KSPGetPC(ksp,&pc); CHKERRQ(ierr);
+        ierr = PCSetType(pc,PCSOR); CHKERRQ(ierr);
+    }
     ierr = SNESSetFromOptions(snes); CHKERRQ(ierr);
 
     // set initial iterate and then solve
@@ -279,6 +365,18 @@ int main(int argc,char **argv) {
                 "problem %s on %s grid:\n"
                 "  error |u-uexact|_inf = %.3e, |u-uexact|_h = %.3e\n",
                 ProblemTypes[problem],gridstr,errinf,err2h); CHKERRQ(ierr);
+    if (bandwidth && dim == 3) {
+        PetscLogDouble bytes, seconds;
+        ierr = Poisson3DResidualTraffic(PETSC_COMM_WORLD,&bytes,&seconds); CHKERRQ(ierr);
+        ierr = PetscPrintf(PETSC_COMM_WORLD,
+                "  3D residuals, all grids and processes: %.3e bytes (model)\n",
+                bytes); CHKERRQ(ierr);
+        if (bwtiming) {
+            ierr = PetscPrintf(PETSC_COMM_WORLD,
+                "      in %.3e s (slowest process) = %.3f GB/s\n",
+                seconds,(seconds > 0.0) ? bytes / seconds / 1.0e9 : 0.0); CHKERRQ(ierr);
+        }
+    }
 
     // destroy what we explicitly Created
     ierr = SNESDestroy(&snes); CHKERRQ(ierr);
@@ -288,45 +386,74 @@ int main(int argc,char **argv) {
 PetscErrorCode Form1DUExact(DMDALocalInfo *info, Vec u, PoissonCtx* user) {
   PetscErrorCode ierr;
   PetscInt   i;
-  PetscReal  xmax[1], xmin[1], hx, x, *au;
+  PetscReal  xmax[1], xmin[1], hx, x, *au, *ag = NULL;
+  Vec        gl;
   ierr = DMGetBoundingBox(info->da,xmin,xmax); CHKERRQ(ierr);
   hx = (xmax[0] - xmin[0]) / (info->mx - 1);
+  ierr = PoissonGetBoundaryValues(info->da,user,&gl); CHKERRQ(ierr);
+  if (gl) {
+      ierr = DMDAVecGetArrayRead(info->da, gl, &ag);CHKERRQ(ierr);
+  }
   ierr = DMDAVecGetArray(info->da, u, &au);CHKERRQ(ierr);
   for (i=info->xs; i<info->xs+info->xm; i++) {
       x = xmin[0] + i * hx;
-      au[i] = user->g_bdry(x,0.0,0.0,user);
+      if (ag && (i==0 || i==info->mx-1))
+          au[i] = ag[i];
+      else
+          au[i] = user->g_bdry(x,0.0,0.0,user);
   }
   ierr = DMDAVecRestoreArray(info->da, u, &au);CHKERRQ(ierr);
+  if (gl) {
+      ierr = DMDAVecRestoreArrayRead(info->da, gl, &ag);CHKERRQ(ierr);
+      ierr = PoissonRestoreBoundaryValues(info->da, user, &gl);CHKERRQ(ierr);
+  }
   return 0;
 }
 
 PetscErrorCode Form2DUExact(DMDALocalInfo *info, Vec u, PoissonCtx* user) {
     PetscErrorCode ierr;
     PetscInt   i, j;
-    PetscReal  xymin[2], xymax[2], hx, hy, x, y, **au;
+    PetscReal  xymin[2], xymax[2], hx, hy, x, y, **au, **ag = NULL;
+    Vec        gl;
     ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
     hx = (xymax[0] - xymin[0]) / (info->mx - 1);
     hy = (xymax[1] - xymin[1]) / (info->my - 1);
+    ierr = PoissonGetBoundaryValues(info->da,user,&gl); CHKERRQ(ierr);
+    if (gl) {
+        ierr = DMDAVecGetArrayRead(info->da, gl, &ag);CHKERRQ(ierr);
+    }
     ierr = DMDAVecGetArray(info->da, u, &au);CHKERRQ(ierr);
     for (j=info->ys; j<info->ys+info->ym; j++) {
         y = xymin[1] + j * hy;
         for (i=info->xs; i<info->xs+info->xm; i++) {
             x = xymin[0] + i * hx;
-            au[j][i] = user->g_bdry(x,y,0.0,user);
+            if (ag && (i==0 || i==info->mx-1 || j==0 || j==info->my-1))
+                au[j][i] = ag[j][i];
+            else
+                au[j][i] = user->g_bdry(x,y,0.0,user);
         }
     }
     ierr = DMDAVecRestoreArray(info->da, u, &au);CHKERRQ(ierr);
+    if (gl) {
+        ierr = DMDAVecRestoreArrayRead(info->da, gl, &ag);CHKERRQ(ierr);
+        ierr = PoissonRestoreBoundaryValues(info->da, user, &gl);CHKERRQ(ierr);
+    }
     return 0;
 }
 
 PetscErrorCode Form3DUExact(DMDALocalInfo *info, Vec u, PoissonCtx* user) {
     PetscErrorCode ierr;
     PetscInt  i, j, k;
-    PetscReal xyzmin[3], xyzmax[3], hx, hy, hz, x, y, z, ***au;
+    PetscReal xyzmin[3], xyzmax[3], hx, hy, hz, x, y, z, ***au, ***ag = NULL;
+    Vec       gl;
     ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
     hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
     hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
     hz = (xyzmax[2] - xyzmin[2]) / (info->mz - 1);
+    ierr = PoissonGetBoundaryValues(info->da,user,&gl); CHKERRQ(ierr);
+    if (gl) {
+        ierr = DMDAVecGetArrayRead(info->da, gl, &ag);CHKERRQ(ierr);
+    }
     ierr = DMDAVecGetArray(info->da, u, &au);CHKERRQ(ierr);
     for (k=info->zs; k<info->zs+info->zm; k++) {
         z = xyzmin[2] + k * hz;
@@ -334,11 +461,19 @@ PetscErrorCode Form3DUExact(DMDALocalInfo *info, Vec u, PoissonCtx* user) {
             y = xyzmin[1] + j * hy;
             for (i=info->xs; i<info->xs+info->xm; i++) {
                 x = xyzmin[0] + i * hx;
-                au[k][j][i] = user->g_bdry(x,y,z,user);
+                if (ag && (i==0 || i==info->mx-1 || j==0 || j==info->my-1
+                                || k==0 || k==info->mz-1))
+                    au[k][j][i] = ag[k][j][i];
+                else
+                    au[k][j][i] = user->g_bdry(x,y,z,user);
             }
         }
     }
     ierr = DMDAVecRestoreArray(info->da, u, &au);CHKERRQ(ierr);
+    if (gl) {
+        ierr = DMDAVecRestoreArrayRead(info->da, gl, &ag);CHKERRQ(ierr);
+        ierr = PoissonRestoreBoundaryValues(info->da, user, &gl);CHKERRQ(ierr);
+    }
     return 0;
 }
 
@@ -4,13 +4,14 @@
 /*
 In 3D these functions approximate the residual of, and the Jacobian of, the
 (slightly-generalized) Poisson equation
-    - cx u_xx - cy u_yy - cz u_zz = f(x,y,z)
+    - cx u_xx - cy u_yy - cz u_zz + n(u,x,y,z) = f(x,y,z)
 with Dirichlet boundary conditions  u = g(x,y,z)  on a domain
 Omega = (0,Lx) x (0,Ly) x (0,Lz) discretized using a DMDA structured grid.
 In 1D and 2D they do the same thing with the obvious reductions of dimension
 in these equations.  (The domain is an interval, rectangle, or rectangular
 solid.)  All of these function work with equally-spaced structured grids.  The
 dimensions hx, hy, hz of the rectangular cells can have any positive values.
+The pointwise term n is optional; if it is null then the equation is linear.
 
 These functions promote code reuse and serve as canonical examples.  They
 are used in ch6/fish.c, ch6/minimal.c, and ch12/obstacle.c.
@@ -22,7 +23,10 @@ designed as call-backs:
              (DMDASNESFunction)PoissonXDFunctionLocal,&user); CHKERRQ(ierr);
 
 A rough estimate is made of the number of flops in the functions
-PoissonXDFunctionLocal().
+PoissonXDFunctionLocal().  In 2D and 3D they compute the residual in two
+passes, the canonical point-by-point formula next to the boundary and a
+branch-free loop in the deep interior, with bit-identical results; see
+poissonfunctions.c.
 
 The PoissonXDJacobianLocal() functions are call-backs which assemble Jacobians
 for the same problems:
@@ -36,6 +40,14 @@ the rows would be scaled in a Galerkin FEM scheme.  (The entries are O(1)
 only if d=2.)  The Dirichlet boundary conditions are approximated using
 diagonal Jacobian entries with the same values as the diagonal entries for
 points in the interior.  Thus these Jacobian matrices have constant diagonal.
+
+If the Jacobian has type MATSHELL, for example from DMSetMatType(da,MATSHELL)
+or -dm_mat_type shell, then the PoissonXDJacobianLocal() functions do not
+assemble.  Instead they give it MatMult(), MatGetDiagonal() and MatSOR()
+operations which are stencil sweeps over DMDA local arrays, and which act as
+the assembled matrix.  Thus Krylov methods and Jacobi, SOR and Chebyshev
+smoothers, including on the levels of -pc_type mg, need no stored matrix.
+See -fsh_matfree in ch6/fish.c.
 */
 
 // warning: the user is in charge of setting up ALL of this content!
@@ -43,14 +55,22 @@ points in the interior.  Thus these Jacobian matrices have constant diagonal.
 typedef struct {
     // domain dimensions
     PetscReal Lx, Ly, Lz;
-    // coefficients in  - cx u_xx - cy u_yy - cz u_zz = f
+    // coefficients in  - cx u_xx - cy u_yy - cz u_zz + n(u,x,y,z) = f
     PetscReal cx, cy, cz;
     // right-hand-side f(x,y,z)
     PetscReal (*f_rhs)(PetscReal x, PetscReal y, PetscReal z, void *ctx);
     // Dirichlet boundary condition g(x,y,z)
     PetscReal (*g_bdry)(PetscReal x, PetscReal y, PetscReal z, void *ctx);
+    // optional pointwise nonlinear term n(u,x,y,z), also returning dn/du in
+    //   *dndu; may be a null ptr
+    PetscReal (*n_term)(PetscReal u, PetscReal x, PetscReal y, PetscReal z,
+                        PetscReal *dndu, void *ctx);
     // additional context; see example usage in ch7/minimal.c
     void   *addctx;
+    // if PETSC_TRUE then g_bdry() values are cached; see below
+    PetscBool cache_gbdry;
+    // tile sizes in i,j for the 3D residual; 0 for automatic; see below
+    PetscInt  tile_i, tile_j;
 } PoissonCtx;
 
 PetscErrorCode Poisson1DFunctionLocal(DMDALocalInfo *info,
@@ -63,6 +83,18 @@ PetscErrorCode Poisson3DFunctionLocal(DMDALocalInfo *info,
     PetscReal ***au, PetscReal ***aF, PoissonCtx *user);
 //ENDDECLARE
 
+/* Poisson3DFunctionLocal() computes the interior of each process's grid in
+tiles of user->tile_i by user->tile_j points, sweeping k within a tile, so that
+three planes of a tile stay in cache.  If tile_i or tile_j is zero then it is
+chosen so that this working set is about half of a typical L2 cache.  The
+following function returns the memory traffic, by a model which counts each
+value of u on a tile (with halo) and of F once, and the time, summed over all
+calls so far, thus over all grids (e.g. multigrid levels).  It is collective
+on comm:  bytes are summed over the processes and seconds are the maximum
+over the processes.  Their ratio is the aggregate effective bandwidth.    */
+PetscErrorCode Poisson3DResidualTraffic(MPI_Comm comm, PetscLogDouble *bytes,
+                                        PetscLogDouble *seconds);
+
 /* This generates a tridiagonal sparse matrix.  If cx=1 then it has 2 on the
 diagonal and -1 or zero in off-diagonal positions.  For example,
     ./fish -fsh_dim 1 -mat_view ::ascii_dense -da_refine N                */
@@ -83,6 +115,31 @@ sparse matrix.  For example,
 PetscErrorCode Poisson3DJacobianLocal(DMDALocalInfo *info, PetscReal ***au,
                                       Mat J, Mat Jpre, PoissonCtx *user);
 
+/* If user->cache_gbdry is PETSC_TRUE then the residual functions, and
+InitialState(), do not call g_bdry() but read a local Vec holding g at the
+boundary points of the (ghosted) local grid, and zero elsewhere.  This Vec is
+a named local vector of the DMDA (see DMGetNamedLocalVector()), built on first
+use by the following function, so there is one per grid; levels of multigrid
+and the finer grids generated by -snes_grid_sequence each get their own.  The
+DMDA owns the Vec; return it with PoissonRestoreBoundaryValues() and do not
+destroy it.  If user->cache_gbdry is PETSC_FALSE then *gl is NULL.        */
+PetscErrorCode PoissonGetBoundaryValues(DM da, PoissonCtx *user, Vec *gl);
+PetscErrorCode PoissonRestoreBoundaryValues(DM da, PoissonCtx *user, Vec *gl);
+
+/* The PoissonXDNGSLocal() functions are red-black nonlinear Gauss-Seidel
+smoothers for the same discretizations, including n(u,x,y,z), and they are
+call-backs for SNESSetNGS():
+
+  ierr = SNESSetNGS(snes,PoissonXDNGSLocal,&user); CHKERRQ(ierr);
+
+They allow -snes_type ngs, and -snes_type fas with -fas_levels_snes_type ngs
+and -fas_coarse_snes_type ngs.  The number of sweeps and the tolerances of
+the pointwise Newton iterations (used only if n_term is not null) come from
+-snes_ngs_sweeps, -snes_ngs_atol, -snes_ngs_rtol, etc.                    */
+PetscErrorCode Poisson1DNGSLocal(SNES snes, Vec u, Vec b, void *ctx);
+PetscErrorCode Poisson2DNGSLocal(SNES snes, Vec u, Vec b, void *ctx);
+PetscErrorCode Poisson3DNGSLocal(SNES snes, Vec u, Vec b, void *ctx);
+
 /* The following function generates an initial iterate using either
   * zero
   * a random function (white noise; *no* smoothness)
@@ -78,6 +78,10 @@ int main(int argc, char **argv) {
     user.cx = 1.0;
     user.cy = 1.0;
     user.cz = 1.0;
+    user.cache_gbdry = PETSC_FALSE;
+    user.tile_i = 0;
+    user.tile_j = 0;
+    user.n_term = NULL;
     ierr = PetscOptionsBegin(PETSC_COMM_WORLD,"ms_",
                              "minimal surface equation solver options",""); CHKERRQ(ierr);
     ierr = PetscOptionsReal("-catenoid_c",
@@ -93,7 +97,7 @@ int main(int argc, char **argv) {
                             "power of (1+|grad u|^2) in diffusivity",
                             "minimal.c",mctx.q,&(mctx.q),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsInt("-quaddegree",
-                            "quadrature degree (=1,2,3) used in -mse_monitor",
+                            "quadrature degree (=1,...,10) used in -mse_monitor",
                             "minimal.c",mctx.quaddegree,&(mctx.quaddegree),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsEnum("-problem",
                             "problem type determines boundary conditions",
@@ -103,6 +107,10 @@ int main(int argc, char **argv) {
                             "'door' height for problem tent",
                             "minimal.c",mctx.tent_H,&(mctx.tent_H),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsEnd(); CHKERRQ(ierr);
+    if ((mctx.quaddegree < 1) || (mctx.quaddegree > MAXPTS)) {
+        SETERRQ1(PETSC_COMM_SELF,6,
+                 "quadrature degree must be in 1,...,%d\n",MAXPTS);
+    }
 
     user.addctx = &mctx;   // attach MSE-specific parameters
     switch (problem) {
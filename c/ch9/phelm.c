@@ -108,10 +108,10 @@ int main(int argc,char **argv) {
                   "phelm.c",ProblemTypes,(PetscEnum)problem,(PetscEnum*)&problem,
                   NULL); CHKERRQ(ierr);
     ierr = PetscOptionsInt("-quadpts",
-                  "number n of quadrature points in each direction (= 1,2,3 only)",
+                  "number n of quadrature points in each direction (= 1,...,10)",
                   "phelm.c",user.quadpts,&(user.quadpts),NULL); CHKERRQ(ierr);
-    if ((user.quadpts < 1) || (user.quadpts > 3)) {
-        SETERRQ(PETSC_COMM_SELF,3,"quadrature points n=1,2,3 only");
+    if ((user.quadpts < 1) || (user.quadpts > MAXPTS)) {
+        SETERRQ1(PETSC_COMM_SELF,3,"quadrature points n=1,...,%d only",MAXPTS);
     }
     ierr = PetscOptionsBool("-view_f",
                   "view right-hand side to STDOUT",
@@ -234,12 +234,6 @@ static PetscReal chi(PetscInt L, PetscReal xi, PetscReal eta) {
     return 0.25 * (1.0 + xiL[L] * xi) * (1.0 + etaL[L] * eta);
 }
 
-// evaluate v(xi,eta) on reference element using local node numbering
-static PetscReal eval(const PetscReal v[4], PetscReal xi, PetscReal eta) {
-    return   v[0] * chi(0,xi,eta) + v[1] * chi(1,xi,eta)
-           + v[2] * chi(2,xi,eta) + v[3] * chi(3,xi,eta);
-}
-
 typedef struct {
     PetscReal  xi, eta;
 } gradRef;
@@ -250,17 +244,6 @@ static gradRef dchi(PetscInt L, PetscReal xi, PetscReal eta) {
     return result;
 }
 
-// evaluate partial derivs of v(xi,eta) on reference element
-static gradRef deval(const PetscReal v[4], PetscReal xi, PetscReal eta) {
-    gradRef   sum = {0.0,0.0}, tmp;
-    PetscInt  L;
-    for (L=0; L<4; L++) {
-        tmp = dchi(L,xi,eta);
-        sum.xi += v[L] * tmp.xi;  sum.eta += v[L] * tmp.eta;
-    }
-    return sum;
-}
-
 static PetscReal GradInnerProd(PetscReal hx, PetscReal hy,
                                gradRef du, gradRef dv) {
     const PetscReal cx = 4.0 / (hx * hx),  cy = 4.0 / (hy * hy);
@@ -273,27 +256,62 @@ static PetscReal GradPow(PetscReal hx, PetscReal hy,
 }
 //ENDFEM
 
-/* FLOPS:  (counting PetscPowScalar as 1)
-     chi = 6
-     eval = 4*6+7 = 31
-     dchi = 8
-     deval = 4*8+4 = 36
+// hat functions and their gradients tabulated at the tensor product
+// quadrature points (xi[r],xi[s]), so they are computed once per residual
+// or objective evaluation instead of at every element
+typedef struct {
+    PetscReal  chi[4][MAXPTS][MAXPTS];
+    gradRef    dchi[4][MAXPTS][MAXPTS];
+} Q1Tab;
+
+static void TabulateQ1(const Quad1D *q, Q1Tab *tab) {
+    PetscInt  L, r, s;
+    for (L = 0; L < 4; L++)
+        for (r = 0; r < q->n; r++)
+            for (s = 0; s < q->n; s++) {
+                tab->chi[L][r][s]  = chi(L,q->xi[r],q->xi[s]);
+                tab->dchi[L][r][s] = dchi(L,q->xi[r],q->xi[s]);
+            }
+}
+
+// evaluate v and its partial derivs on reference element, using local node
+// numbering, at tabulated point (xi[r],xi[s])
+static PetscReal eval(const PetscReal v[4], const Q1Tab *tab,
+                      PetscInt r, PetscInt s) {
+    return   v[0] * tab->chi[0][r][s] + v[1] * tab->chi[1][r][s]
+           + v[2] * tab->chi[2][r][s] + v[3] * tab->chi[3][r][s];
+}
+
+static gradRef deval(const PetscReal v[4], const Q1Tab *tab,
+                     PetscInt r, PetscInt s) {
+    gradRef   sum = {0.0,0.0}, tmp;
+    PetscInt  L;
+    for (L=0; L<4; L++) {
+        tmp = tab->dchi[L][r][s];
+        sum.xi += v[L] * tmp.xi;  sum.eta += v[L] * tmp.eta;
+    }
+    return sum;
+}
+
+/* FLOPS:  (counting PetscPowScalar as 1; chi, dchi are tabulated)
+     eval = 7
+     deval = 4*4 = 16
      GradInnerProd = 9
      GradPow = 9+4 = 13
-     ObjIntegrandRef = deval + 2*eval + GradPow + 10 = 121
-     FunIntegrandRef = chi + dchi + 2*eval + deval + GradPo + GradInnerProd + 9
-                     = 143
+     ObjIntegrandRef = deval + 2*eval + GradPow + 10 = 53
+     FunIntegrandRef = 2*eval + deval + GradPow + GradInnerProd + 9 = 61
 */
 
 //STARTOBJECTIVE
 static PetscReal ObjIntegrandRef(DMDALocalInfo *info,
                        const PetscReal ff[4], const PetscReal uu[4],
-                       PetscReal xi, PetscReal eta, PHelmCtx *user) {
-    const gradRef    du = deval(uu,xi,eta);
+                       const Q1Tab *tab, PetscInt r, PetscInt s,
+                       PHelmCtx *user) {
+    const gradRef    du = deval(uu,tab,r,s);
     const PetscReal  hx = 1.0 / (info->mx-1),  hy = 1.0 / (info->my-1),
-                     u = eval(uu,xi,eta);
+                     u = eval(uu,tab,r,s);
     return GradPow(hx,hy,du,user->p,0.0) / user->p + 0.5 * u * u
-           - eval(ff,xi,eta) * u;
+           - eval(ff,tab,r,s) * u;
 }
 
 PetscErrorCode FormObjectiveLocal(DMDALocalInfo *info, PetscReal **au,
@@ -304,6 +322,9 @@ PetscErrorCode FormObjectiveLocal(DMDALocalInfo *info, PetscReal **au,
   PetscReal       x, y, lobj = 0.0;
   PetscInt        i,j,r,s;
   MPI_Comm        com;
+  Q1Tab           tab;
+
+  TabulateQ1(&q,&tab);
 
   // loop over all elements
   for (j = info->ys; j < info->ys + info->ym; j++) {
@@ -324,8 +345,7 @@ PetscErrorCode FormObjectiveLocal(DMDALocalInfo *info, PetscReal **au,
           for (r = 0; r < q.n; r++) {
               for (s = 0; s < q.n; s++) {
                   lobj += q.w[r] * q.w[s]
-                          * ObjIntegrandRef(info,ff,uu,
-                                            q.xi[r],q.xi[s],user);
+                          * ObjIntegrandRef(info,ff,uu,&tab,r,s,user);
               }
           }
       }
@@ -333,7 +353,7 @@ PetscErrorCode FormObjectiveLocal(DMDALocalInfo *info, PetscReal **au,
   lobj *= hx * hy / 4.0;  // from change of variables formula
   ierr = PetscObjectGetComm((PetscObject)(info->da),&com); CHKERRQ(ierr);
   ierr = MPI_Allreduce(&lobj,obj,1,MPIU_REAL,MPIU_SUM,com); CHKERRQ(ierr);
-  ierr = PetscLogFlops(129*info->xm*info->ym); CHKERRQ(ierr);
+  ierr = PetscLogFlops(61*info->xm*info->ym); CHKERRQ(ierr);
   return 0;
 }
 //ENDOBJECTIVE
@@ -341,13 +361,14 @@ PetscErrorCode FormObjectiveLocal(DMDALocalInfo *info, PetscReal **au,
 //STARTFUNCTION
 static PetscReal IntegrandRef(DMDALocalInfo *info, PetscInt L,
                      const PetscReal ff[4], const PetscReal uu[4],
-                     PetscReal xi, PetscReal eta, PHelmCtx *user) {
-  const gradRef    du    = deval(uu,xi,eta),
-                   dchiL = dchi(L,xi,eta);
+                     const Q1Tab *tab, PetscInt r, PetscInt s,
+                     PHelmCtx *user) {
+  const gradRef    du    = deval(uu,tab,r,s),
+                   dchiL = tab->dchi[L][r][s];
   const PetscReal  hx = 1.0 / (info->mx-1),  hy = 1.0 / (info->my-1);
   return GradPow(hx,hy,du,user->p - 2.0,user->eps)
            * GradInnerProd(hx,hy,du,dchiL)
-         + (eval(uu,xi,eta) - eval(ff,xi,eta)) * chi(L,xi,eta);
+         + (eval(uu,tab,r,s) - eval(ff,tab,r,s)) * tab->chi[L][r][s];
 }
 
 PetscErrorCode FormFunctionLocal(DMDALocalInfo *info, PetscReal **au,
@@ -358,6 +379,9 @@ PetscErrorCode FormFunctionLocal(DMDALocalInfo *info, PetscReal **au,
   const PetscInt  li[4] = {0,-1,-1,0},  lj[4] = {0,0,-1,-1};
   PetscReal       x, y;
   PetscInt        i,j,l,r,s,PP,QQ;
+  Q1Tab           tab;
+
+  TabulateQ1(&q,&tab);
 
   // clear residuals
   for (j = info->ys; j < info->ys + info->ym; j++)
@@ -391,15 +415,14 @@ PetscErrorCode FormFunctionLocal(DMDALocalInfo *info, PetscReal **au,
                       for (s = 0; s < q.n; s++) {
                          FF[QQ][PP]
                              += 0.25 * hx * hy * q.w[r] * q.w[s]
-                                * IntegrandRef(info,l,ff,uu,
-                                               q.xi[r],q.xi[s],user);
+                                * IntegrandRef(info,l,ff,uu,&tab,r,s,user);
                       }
                   }
               }
           }
       }
   }
-  ierr = PetscLogFlops((5+q.n*q.n*149)*(info->xm+1)*(info->ym+1)); CHKERRQ(ierr);
+  ierr = PetscLogFlops((5+q.n*q.n*67)*(info->xm+1)*(info->ym+1)); CHKERRQ(ierr);
   return 0;
 }
 //ENDFUNCTION
@@ -2,7 +2,7 @@
 #define QUADRATURE_H_
 
 //STARTONEDIM
-#define MAXPTS 3
+#define MAXPTS 10
 
 typedef struct {
     PetscInt   n;          // number of quadrature points for this rule
@@ -10,7 +10,9 @@ typedef struct {
                w[MAXPTS];  // weights (sum to 2)
 } Quad1D;
 
-static const Quad1D gausslegendre[3]
+// Gauss-Legendre rule with n points is gausslegendre[n-1]; it is exact for
+// polynomials of degree 2n-1; entries of xi[],w[] beyond n are not used
+static const Quad1D gausslegendre[MAXPTS]
     = {  {1,
           {0.0,                NAN,               NAN},
           {2.0,                NAN,               NAN}},
@@ -19,11 +21,43 @@ static const Quad1D gausslegendre[3]
           {1.0,                1.0,               NAN}},
          {3,
           {-0.774596669241483, 0.0,               0.774596669241483},
-          {0.555555555555556,  0.888888888888889, 0.555555555555556}} };
+          {0.555555555555556,  0.888888888888889, 0.555555555555556}},
+         {4,
+          {-0.861136311594053, -0.339981043584856, 0.339981043584856, 0.861136311594053},
+          {0.347854845137454, 0.652145154862546, 0.652145154862546, 0.347854845137454}},
+         {5,
+          {-0.906179845938664, -0.538469310105683, 0.0, 0.538469310105683, 0.906179845938664},
+          {0.236926885056189, 0.478628670499366, 0.568888888888889, 0.478628670499366, 0.236926885056189}},
+         {6,
+          {-0.932469514203152, -0.661209386466265, -0.238619186083197, 0.238619186083197, 0.661209386466265,
+           0.932469514203152},
+          {0.171324492379170, 0.360761573048139, 0.467913934572691, 0.467913934572691, 0.360761573048139,
+           0.171324492379170}},
+         {7,
+          {-0.949107912342758, -0.741531185599394, -0.405845151377397, 0.0, 0.405845151377397,
+           0.741531185599394, 0.949107912342758},
+          {0.129484966168870, 0.279705391489277, 0.381830050505119, 0.417959183673469, 0.381830050505119,
+           0.279705391489277, 0.129484966168870}},
+         {8,
+          {-0.960289856497536, -0.796666477413627, -0.525532409916329, -0.183434642495650, 0.183434642495650,
+           0.525532409916329, 0.796666477413627, 0.960289856497536},
+          {0.101228536290376, 0.222381034453374, 0.313706645877887, 0.362683783378362, 0.362683783378362,
+           0.313706645877887, 0.222381034453374, 0.101228536290376}},
+         {9,
+          {-0.968160239507626, -0.836031107326636, -0.613371432700590, -0.324253423403809, 0.0,
+           0.324253423403809, 0.613371432700590, 0.836031107326636, 0.968160239507626},
+          {0.081274388361575, 0.180648160694857, 0.260610696402935, 0.312347077040003, 0.330239355001260,
+           0.312347077040003, 0.260610696402935, 0.180648160694857, 0.081274388361575}},
+         {10,
+          {-0.973906528517172, -0.865063366688985, -0.679409568299024, -0.433395394129247, -0.148874338981631,
+           0.148874338981631, 0.433395394129247, 0.679409568299024, 0.865063366688985, 0.973906528517172},
+          {0.066671344308688, 0.149451349150581, 0.219086362515982, 0.269266719309996, 0.295524224714753,
+           0.295524224714753, 0.269266719309996, 0.219086362515982, 0.149451349150581, 0.066671344308688}} };
 //ENDONEDIM
 
 //STARTTRIANGLE
-#define MAXPTS_TRI 4
+#define MAXPTS_TRI 25
+#define MAXDEGREE_TRI 10
 
 typedef struct {
     PetscInt   n;               // number of quad. points for this rule
@@ -32,7 +66,11 @@ typedef struct {
                w[MAXPTS_TRI];   // weights (sum to 0.5)
 } Quad2DTri;
 
-static const Quad2DTri symmgauss[3]
+// symmetric rule of degree d is symmgauss[d-1], exact for polynomials of
+// degree d; weights are positive and points are interior to the triangle;
+// degrees 4,5,6,8,9,10 are from Dunavant (1985), degree 3 is the 6-point rule
+// of Strang & Fix (1973); entries beyond n are not used
+static const Quad2DTri symmgauss[MAXDEGREE_TRI]
     = {  {1,
           {1.0/3.0,    NAN,       NAN,       NAN},
           {1.0/3.0,    NAN,       NAN,       NAN},
@@ -41,10 +79,101 @@ static const Quad2DTri symmgauss[3]
           {1.0/6.0,    2.0/3.0,   1.0/6.0,   NAN},
           {1.0/6.0,    1.0/6.0,   2.0/3.0,   NAN},
           {1.0/6.0,    1.0/6.0,   1.0/6.0,   NAN}},
-         {4,
-          {1.0/3.0,    1.0/5.0,   3.0/5.0,   1.0/5.0},
-          {1.0/3.0,    1.0/5.0,   1.0/5.0,   3.0/5.0},
-          {-27.0/96.0, 25.0/96.0, 25.0/96.0, 25.0/96.0}}  };
+         {6,  // degree 3
+          {0.231933368553031, 0.109039009072877, 0.659027622374092, 0.109039009072877,
+           0.659027622374092, 0.231933368553031},
+          {0.109039009072877, 0.231933368553031, 0.109039009072877, 0.659027622374092,
+           0.231933368553031, 0.659027622374092},
+          {1.0/12.0,   1.0/12.0,   1.0/12.0,   1.0/12.0,
+           1.0/12.0,   1.0/12.0}},
+         {6,  // degree 4
+          {0.445948490915965, 0.108103018168070, 0.445948490915965, 0.091576213509771,
+           0.816847572980459, 0.091576213509771},
+          {0.445948490915965, 0.445948490915965, 0.108103018168070, 0.091576213509771,
+           0.091576213509771, 0.816847572980459},
+          {0.111690794839005, 0.111690794839005, 0.111690794839005, 0.054975871827661,
+           0.054975871827661, 0.054975871827661}},
+         {7,  // degree 5
+          {0.333333333333333, 0.470142064105115, 0.059715871789770, 0.470142064105115,
+           0.101286507323456, 0.797426985353087, 0.101286507323456},
+          {0.333333333333333, 0.470142064105115, 0.470142064105115, 0.059715871789770,
+           0.101286507323456, 0.101286507323456, 0.797426985353087},
+          {0.112500000000000, 0.066197076394253, 0.066197076394253, 0.066197076394253,
+           0.062969590272414, 0.062969590272414, 0.062969590272414}},
+         {12,  // degree 6
+          {0.249286745170910, 0.501426509658179, 0.249286745170910, 0.063089014491502,
+           0.873821971016996, 0.063089014491502, 0.310352451033784, 0.636502499121399,
+           0.053145049844817, 0.636502499121399, 0.053145049844817, 0.310352451033784},
+          {0.249286745170910, 0.249286745170910, 0.501426509658179, 0.063089014491502,
+           0.063089014491502, 0.873821971016996, 0.636502499121399, 0.310352451033784,
+           0.636502499121399, 0.053145049844817, 0.310352451033784, 0.053145049844817},
+          {0.058393137863189, 0.058393137863189, 0.058393137863189, 0.025422453185103,
+           0.025422453185103, 0.025422453185103, 0.041425537809187, 0.041425537809187,
+           0.041425537809187, 0.041425537809187, 0.041425537809187, 0.041425537809187}},
+         {16,  // degree 7 (uses degree 8 rule)
+          {0.333333333333333, 0.459292588292723, 0.081414823414554, 0.459292588292723,
+           0.170569307751760, 0.658861384496480, 0.170569307751760, 0.050547228317031,
+           0.898905543365938, 0.050547228317031, 0.263112829634638, 0.728492392955404,
+           0.008394777409958, 0.728492392955404, 0.008394777409958, 0.263112829634638},
+          {0.333333333333333, 0.459292588292723, 0.459292588292723, 0.081414823414554,
+           0.170569307751760, 0.170569307751760, 0.658861384496480, 0.050547228317031,
+           0.050547228317031, 0.898905543365938, 0.728492392955404, 0.263112829634638,
+           0.728492392955404, 0.008394777409958, 0.263112829634638, 0.008394777409958},
+          {0.072157803838894, 0.047545817133642, 0.047545817133642, 0.047545817133642,
+           0.051608685267359, 0.051608685267359, 0.051608685267359, 0.016229248811599,
+           0.016229248811599, 0.016229248811599, 0.013615157087217, 0.013615157087217,
+           0.013615157087217, 0.013615157087217, 0.013615157087217, 0.013615157087217}},
+         {16,  // degree 8
+          {0.333333333333333, 0.459292588292723, 0.081414823414554, 0.459292588292723,
+           0.170569307751760, 0.658861384496480, 0.170569307751760, 0.050547228317031,
+           0.898905543365938, 0.050547228317031, 0.263112829634638, 0.728492392955404,
+           0.008394777409958, 0.728492392955404, 0.008394777409958, 0.263112829634638},
+          {0.333333333333333, 0.459292588292723, 0.459292588292723, 0.081414823414554,
+           0.170569307751760, 0.170569307751760, 0.658861384496480, 0.050547228317031,
+           0.050547228317031, 0.898905543365938, 0.728492392955404, 0.263112829634638,
+           0.728492392955404, 0.008394777409958, 0.263112829634638, 0.008394777409958},
+          {0.072157803838894, 0.047545817133642, 0.047545817133642, 0.047545817133642,
+           0.051608685267359, 0.051608685267359, 0.051608685267359, 0.016229248811599,
+           0.016229248811599, 0.016229248811599, 0.013615157087217, 0.013615157087217,
+           0.013615157087217, 0.013615157087217, 0.013615157087217, 0.013615157087217}},
+         {19,  // degree 9
+          {0.333333333333333, 0.489682519198738, 0.020634961602525, 0.489682519198738,
+           0.437089591492937, 0.125820817014127, 0.437089591492937, 0.188203535619033,
+           0.623592928761935, 0.188203535619033, 0.044729513394453, 0.910540973211095,
+           0.044729513394453, 0.221962989160766, 0.741198598784498, 0.036838412054736,
+           0.741198598784498, 0.036838412054736, 0.221962989160766},
+          {0.333333333333333, 0.489682519198738, 0.489682519198738, 0.020634961602525,
+           0.437089591492937, 0.437089591492937, 0.125820817014127, 0.188203535619033,
+           0.188203535619033, 0.623592928761935, 0.044729513394453, 0.044729513394453,
+           0.910540973211095, 0.741198598784498, 0.221962989160766, 0.741198598784498,
+           0.036838412054736, 0.221962989160766, 0.036838412054736},
+          {0.048567898141400, 0.015667350113570, 0.015667350113570, 0.015667350113570,
+           0.038913770502387, 0.038913770502387, 0.038913770502387, 0.039823869463605,
+           0.039823869463605, 0.039823869463605, 0.012788837829349, 0.012788837829349,
+           0.012788837829349, 0.021641769688645, 0.021641769688645, 0.021641769688645,
+           0.021641769688645, 0.021641769688645, 0.021641769688645}},
+         {25,  // degree 10
+          {0.333333333333333, 0.485577633383657, 0.028844733232685, 0.485577633383657,
+           0.109481575485037, 0.781036849029926, 0.109481575485037, 0.307939838764121,
+           0.550352941820999, 0.141707219414880, 0.550352941820999, 0.141707219414880,
+           0.307939838764121, 0.246672560639903, 0.728323904597411, 0.025003534762686,
+           0.728323904597411, 0.025003534762686, 0.246672560639903, 0.066803251012200,
+           0.923655933587500, 0.009540815400299, 0.923655933587500, 0.009540815400299,
+           0.066803251012200},
+          {0.333333333333333, 0.485577633383657, 0.485577633383657, 0.028844733232685,
+           0.109481575485037, 0.109481575485037, 0.781036849029926, 0.550352941820999,
+           0.307939838764121, 0.550352941820999, 0.141707219414880, 0.307939838764121,
+           0.141707219414880, 0.728323904597411, 0.246672560639903, 0.728323904597411,
+           0.025003534762686, 0.246672560639903, 0.025003534762686, 0.923655933587500,
+           0.066803251012200, 0.923655933587500, 0.009540815400299, 0.066803251012200,
+           0.009540815400299},
+          {0.045408995191377, 0.018362978878233, 0.018362978878233, 0.018362978878233,
+           0.022660529717764, 0.022660529717764, 0.022660529717764, 0.036378958422710,
+           0.036378958422710, 0.036378958422710, 0.036378958422710, 0.036378958422710,
+           0.036378958422710, 0.014163621265528, 0.014163621265528, 0.014163621265528,
+           0.014163621265528, 0.014163621265528, 0.014163621265528, 0.004710833481867,
+           0.004710833481867, 0.004710833481867, 0.004710833481867, 0.004710833481867,
+           0.004710833481867}}  };
 //ENDTRIANGLE
 
 #endif